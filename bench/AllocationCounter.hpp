@@ -0,0 +1,74 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <malloc.h>
+
+// Counts every heap allocation in the process by wrapping glibc's allocator, which also catches operator new and
+// OpenCV's own buffers
+// Defines malloc and friends, so include it from exactly one source file per executable
+
+namespace allocationCounter
+{
+inline std::atomic<size_t> &count()
+{
+    static std::atomic<size_t> allocations{0};
+    return allocations;
+}
+
+inline void add()
+{
+    count().fetch_add(1, std::memory_order_relaxed);
+}
+} // namespace allocationCounter
+
+extern "C"
+{
+    void *__libc_malloc(size_t size);
+    void *__libc_calloc(size_t count, size_t size);
+    void *__libc_realloc(void *pointer, size_t size);
+    void *__libc_memalign(size_t alignment, size_t size);
+    void __libc_free(void *pointer);
+
+    void *malloc(size_t size)
+    {
+        allocationCounter::add();
+        return __libc_malloc(size);
+    }
+
+    void *calloc(size_t count, size_t size)
+    {
+        allocationCounter::add();
+        return __libc_calloc(count, size);
+    }
+
+    void *realloc(void *pointer, size_t size)
+    {
+        allocationCounter::add();
+        return __libc_realloc(pointer, size);
+    }
+
+    void *memalign(size_t alignment, size_t size)
+    {
+        allocationCounter::add();
+        return __libc_memalign(alignment, size);
+    }
+
+    void *aligned_alloc(size_t alignment, size_t size)
+    {
+        allocationCounter::add();
+        return __libc_memalign(alignment, size);
+    }
+
+    int posix_memalign(void **pointer, size_t alignment, size_t size)
+    {
+        allocationCounter::add();
+        *pointer = __libc_memalign(alignment, size);
+        return *pointer == nullptr ? 12 : 0;
+    }
+
+    void free(void *pointer)
+    {
+        __libc_free(pointer);
+    }
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+// Loads recorded frames from a directory of images, or failing that from a video file
+inline std::vector<cv::Mat> loadFrames(const std::string &source)
+{
+    std::vector<cv::Mat> frames;
+
+    std::vector<cv::String> files;
+    cv::glob(source + "/*", files);
+    for (const cv::String &file : files)
+    {
+        cv::Mat frame{cv::imread(file, cv::IMREAD_COLOR)};
+        if (!frame.empty())
+            frames.push_back(frame);
+    }
+
+    if (frames.empty())
+    {
+        cv::VideoCapture video{source};
+        cv::Mat frame;
+        while (video.read(frame))
+            frames.push_back(frame.clone());
+    }
+
+    return frames;
+}
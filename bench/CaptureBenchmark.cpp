@@ -0,0 +1,64 @@
+#include <iostream>
+#include <string>
+#include <opencv2/opencv.hpp>
+
+#include "GstCapture.hpp"
+
+// Compares cv::VideoCapture against GstCapture on the same GStreamer source, no camera needed
+// Usage: CaptureBenchmark [source] [frames]
+// e.g. CaptureBenchmark "filesrc location=match.mp4 ! decodebin" 300
+
+double millisecondsSince(int64 start)
+{
+    return (cv::getTickCount() - start) * 1000.0 / cv::getTickFrequency();
+}
+
+int main(int argc, char *argv[])
+{
+    std::string source{argc > 1 ? argv[1] : "videotestsrc pattern=ball ! video/x-raw,width=320,height=240"};
+    int frames{argc > 2 ? std::stoi(argv[2]) : 500};
+
+    // Touches every frame once so both paths pay for getting the pixels into cache
+    int checksum{0};
+
+    cv::VideoCapture videoCapture{source + " ! videoconvert ! video/x-raw,format=BGR ! appsink", cv::CAP_GSTREAMER};
+    if (videoCapture.isOpened())
+    {
+        cv::Mat frame;
+        int read{0};
+        int64 start{cv::getTickCount()};
+        for (; read < frames && videoCapture.read(frame); ++read)
+            checksum += frame.data[frame.total() * 3 / 2];
+
+        double milliseconds{millisecondsSince(start)};
+        std::cout << "cv::VideoCapture: " << read << " frames, " << milliseconds / read << " ms/frame, " << read * 1000 / milliseconds << " fps\n";
+    }
+    else
+    {
+        std::cout << "cv::VideoCapture could not open the source\n";
+    }
+
+    GstCapture gstCapture{source};
+    if (gstCapture.open())
+    {
+        GstCapture::Buffer buffer;
+        int read{0};
+        int64 start{cv::getTickCount()};
+        for (; read < frames && !gstCapture.isEndOfStream(); ++read)
+        {
+            if (!gstCapture.read(buffer, std::chrono::milliseconds{1000}))
+                break;
+            checksum += buffer.frame.data[buffer.frame.total() * 3 / 2];
+        }
+
+        double milliseconds{millisecondsSince(start)};
+        std::cout << "GstCapture: " << read << " frames, " << milliseconds / read << " ms/frame, " << read * 1000 / milliseconds << " fps\n";
+    }
+    else
+    {
+        std::cout << "GstCapture could not open the source\n";
+    }
+
+    std::cout << "Checksum " << checksum << '\n';
+    return 0;
+}
@@ -0,0 +1,160 @@
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+#include "BlobExtractor.hpp"
+#include "Contour.hpp"
+
+// Times Contour::isValid() against the validation it replaced, on thousands of synthetic blobs, no camera needed
+// The blobs are drawn into a mask and outlined by BlobExtractor like the pipeline does: a mix of strips, flat blobs
+// and specks, so both the early rejections and the full fit get exercised
+// The old validation measured whichever edge of the rotated rectangle was steeper, so it passes the flat blobs too
+// Usage: ContourBenchmark [contours] [iterations]
+
+// The settings from resources/config.yaml
+constexpr double minArea{60}, maxArea{5000}, minRotation{30};
+constexpr int allowableError{3};
+
+// Blobs are drawn in a grid of cells this big, so they never touch
+constexpr int cellSize{64};
+
+// Contour::isValid() as it was, filling in the same members
+bool isValidOld(Contour &contour, double minArea, double maxArea, double minRotation, int error)
+{
+    cv::Mat pointsMat{contour.pointCount, 1, CV_32SC2, const_cast<cv::Point *>(contour.points)};
+
+    static thread_local std::vector<cv::Point> newPoly;
+    cv::approxPolyDP(pointsMat, newPoly, error, true);
+
+    contour.area = cv::contourArea(pointsMat);
+    contour.rotatedBoundingBox = cv::minAreaRect(newPoly);
+
+    if (contour.area < minArea || contour.area > maxArea)
+        return false;
+
+    contour.rotatedBoundingBox.points(contour.rotatedBoundingBoxPoints);
+
+    int highestPoint{0}, secondLowestPoint{0};
+    for (int i{0}; i < 4; ++i)
+    {
+        int pointsHigherThan{0}, pointsLowerThan{0};
+
+        for (int o{0}; o < 4; ++o)
+        {
+            if (contour.rotatedBoundingBoxPoints[i].y < contour.rotatedBoundingBoxPoints[o].y)
+                ++pointsHigherThan;
+            if (contour.rotatedBoundingBoxPoints[i].y > contour.rotatedBoundingBoxPoints[o].y)
+                ++pointsLowerThan;
+        }
+
+        if (pointsHigherThan == 3)
+            highestPoint = i;
+        else if (pointsLowerThan == 2)
+            secondLowestPoint = i;
+    }
+
+    const cv::Point2f *corners{contour.rotatedBoundingBoxPoints};
+    contour.angle = std::atan((corners[secondLowestPoint].y - corners[highestPoint].y) / (corners[highestPoint].x - corners[secondLowestPoint].x)) * 180 / 3.1415926;
+
+    if ((contour.angle < 0 && contour.angle > -minRotation) || (contour.angle > 0 && contour.angle < minRotation))
+        return false;
+
+    contour.boundingBox = cv::boundingRect(newPoly);
+
+    return true;
+}
+
+cv::Mat makeMask(int blobs, std::mt19937 &random)
+{
+    int columns{static_cast<int>(std::ceil(std::sqrt(blobs)))};
+    int rows{(blobs + columns - 1) / columns};
+    cv::Mat mask{rows * cellSize, columns * cellSize, CV_8UC1, cv::Scalar::all(0)};
+
+    std::uniform_real_distribution<double> kind{0, 1}, stripLength{14, 56}, lean{-25, 25}, flatLean{50, 90}, speckSize{2, 7};
+    for (int b{0}; b < blobs; ++b)
+    {
+        cv::Point2f center{static_cast<float>((b % columns + 0.5) * cellSize), static_cast<float>((b / columns + 0.5) * cellSize)};
+
+        // Strips are 2 by 5.5 inches, and lean in or out from vertical by the angle
+        cv::RotatedRect shape;
+        double choice{kind(random)};
+        if (choice < 0.3)
+        {
+            double length{stripLength(random)};
+            shape = cv::RotatedRect{center, cv::Size2f{static_cast<float>(length / 2.75), static_cast<float>(length)}, static_cast<float>(lean(random))};
+        }
+        else if (choice < 0.5)
+        {
+            double length{stripLength(random)};
+            shape = cv::RotatedRect{center, cv::Size2f{static_cast<float>(length / 2.75), static_cast<float>(length)}, static_cast<float>(flatLean(random))};
+        }
+        else
+        {
+            double size{speckSize(random)};
+            shape = cv::RotatedRect{center, cv::Size2f{static_cast<float>(size), static_cast<float>(size * 1.5)}, static_cast<float>(lean(random))};
+        }
+
+        cv::Point2f corners[4];
+        shape.points(corners);
+        cv::Point polygon[4];
+        for (int c{0}; c < 4; ++c)
+            polygon[c] = cv::Point{cvRound(corners[c].x), cvRound(corners[c].y)};
+        cv::fillConvexPoly(mask, polygon, 4, cv::Scalar::all(255));
+    }
+
+    return mask;
+}
+
+int main(int argc, char *argv[])
+{
+    int blobs{argc > 1 ? std::stoi(argv[1]) : 5000};
+    int iterations{argc > 2 ? std::stoi(argv[2]) : 20};
+
+    std::mt19937 random{2851};
+    cv::Mat mask{makeMask(blobs, random)};
+
+    BlobExtractor extractor;
+    extractor.extract(mask);
+
+    // Outlines are laid out back to back in one arena, like the pipeline's, and never move once they're all added
+    std::vector<cv::Point> points;
+    std::vector<int> firstPoints;
+    for (size_t blob{0}; blob < static_cast<size_t>(extractor.getStats().size()); ++blob)
+    {
+        firstPoints.push_back(points.size());
+        extractor.appendOutline(static_cast<int>(blob), points);
+    }
+    firstPoints.push_back(points.size());
+
+    std::vector<Contour> contours;
+    for (size_t c{0}; c + 1 < firstPoints.size(); ++c)
+        contours.push_back(Contour{points.data() + firstPoints[c], firstPoints[c + 1] - firstPoints[c]});
+
+    std::cout << contours.size() << " contours, " << iterations << " iterations\n";
+
+    size_t valid{0};
+    int64 start{cv::getTickCount()};
+    for (int i{0}; i < iterations; ++i)
+    {
+        for (Contour &contour : contours)
+            valid += contour.isValid(minArea, maxArea, minRotation, allowableError);
+    }
+    double newMicroseconds{(cv::getTickCount() - start) * 1e6 / cv::getTickFrequency() / (iterations * contours.size())};
+
+    size_t oldValid{0};
+    start = cv::getTickCount();
+    for (int i{0}; i < iterations; ++i)
+    {
+        for (Contour &contour : contours)
+            oldValid += isValidOld(contour, minArea, maxArea, minRotation, allowableError);
+    }
+    double oldMicroseconds{(cv::getTickCount() - start) * 1e6 / cv::getTickFrequency() / (iterations * contours.size())};
+
+    std::cout << "Contour::isValid: " << newMicroseconds << " us/contour, " << valid / iterations << " valid\n"
+              << "Old validation: " << oldMicroseconds << " us/contour, " << oldValid / iterations << " valid\n";
+
+    return 0;
+}
@@ -0,0 +1,119 @@
+#include <array>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+#include "Contour.hpp"
+#include "TargetPairer.hpp"
+
+// Times TargetPairer against the nested loop it replaced, on synthetic frames of validated strips, no camera needed
+// Each frame is mostly real-looking targets with some lone strips mixed in, like a field full of reflections
+// Usage: PairingBenchmark [strips per frame] [frames] [iterations]
+
+// A validated strip, as Contour::isValid() would have left it
+Contour makeStrip(double x, double y, double length, double angle)
+{
+    Contour strip;
+    strip.rotatedBoundingBox = cv::RotatedRect{cv::Point2f{static_cast<float>(x), static_cast<float>(y)},
+                                               cv::Size2f{static_cast<float>(length / 2.75), static_cast<float>(length)}, static_cast<float>(-angle)};
+    strip.rotatedBoundingBox.points(strip.rotatedBoundingBoxPoints);
+    strip.boundingBox = strip.rotatedBoundingBox.boundingRect();
+    strip.area = length * length / 2.75;
+    strip.angle = angle;
+    return strip;
+}
+
+std::vector<Contour> makeFrame(int strips, std::mt19937 &random)
+{
+    std::uniform_real_distribution<double> x{0, 640}, y{20, 460}, length{8, 40}, lean{60, 85}, coin{0, 1};
+
+    std::vector<Contour> contours;
+    while (static_cast<int>(contours.size()) < strips)
+    {
+        double stripLength{length(random)}, centerX{x(random)}, centerY{y(random)}, angle{lean(random)};
+        if (coin(random) < 0.8)
+        {
+            // A target: strips leaning towards each other a little over two lengths apart
+            contours.push_back(makeStrip(centerX - stripLength * 1.1, centerY, stripLength, angle));
+            contours.push_back(makeStrip(centerX + stripLength * 1.1, centerY, stripLength, -angle));
+        }
+        else
+        {
+            contours.push_back(makeStrip(centerX, centerY, stripLength, coin(random) < 0.5 ? angle : -angle));
+        }
+    }
+
+    std::shuffle(contours.begin(), contours.end(), random);
+    return contours;
+}
+
+// The pairing loop as it was, minus the pair center comparison that followed it, and looking for every pair rather
+// than stopping at the first like the sweep does. Stopping early hid its O(n²) cost by missing all but one target
+void pairNested(const std::vector<Contour> &contours, std::vector<std::array<int, 2>> &pairs)
+{
+    pairs.clear();
+    for (int origContour{0}; origContour < contours.size(); ++origContour)
+    {
+        if (contours.at(origContour).angle > 0)
+        {
+            int leastDistantContour{-1};
+            for (int compareContour{0}; compareContour < contours.size(); ++compareContour)
+            {
+                if (compareContour != origContour && contours.at(compareContour).angle < 0 && contours.at(origContour).rotatedBoundingBoxPoints[0].x < contours.at(compareContour).rotatedBoundingBoxPoints[0].x)
+                {
+                    if (leastDistantContour == -1)
+                        leastDistantContour = compareContour;
+                    else if (contours.at(compareContour).rotatedBoundingBoxPoints[0].x - contours.at(origContour).rotatedBoundingBoxPoints[0].x < contours.at(leastDistantContour).rotatedBoundingBoxPoints[0].x)
+                        leastDistantContour = compareContour;
+                }
+            }
+
+            if (leastDistantContour != -1)
+                pairs.push_back(std::array<int, 2>{origContour, leastDistantContour});
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    int strips{argc > 1 ? std::stoi(argv[1]) : 400};
+    int frameCount{argc > 2 ? std::stoi(argv[2]) : 100};
+    int iterations{argc > 3 ? std::stoi(argv[3]) : 20};
+
+    std::mt19937 random{2851};
+    std::vector<std::vector<Contour>> frames;
+    for (int f{0}; f < frameCount; ++f)
+        frames.push_back(makeFrame(strips, random));
+
+    std::cout << frameCount << " frames of " << strips << " strips, " << iterations << " iterations\n";
+
+    TargetPairer pairer;
+    size_t pairsFound{0};
+    int64 start{cv::getTickCount()};
+    for (int i{0}; i < iterations; ++i)
+    {
+        for (const std::vector<Contour> &contours : frames)
+            pairsFound += pairer.pair(contours, 640).size();
+    }
+    double sweepMilliseconds{(cv::getTickCount() - start) * 1000.0 / cv::getTickFrequency() / (iterations * frameCount)};
+
+    std::vector<std::array<int, 2>> nestedPairs;
+    size_t nestedPairsFound{0};
+    start = cv::getTickCount();
+    for (int i{0}; i < iterations; ++i)
+    {
+        for (const std::vector<Contour> &contours : frames)
+        {
+            pairNested(contours, nestedPairs);
+            nestedPairsFound += nestedPairs.size();
+        }
+    }
+    double nestedMilliseconds{(cv::getTickCount() - start) * 1000.0 / cv::getTickFrequency() / (iterations * frameCount)};
+
+    std::cout << "Sort and sweep: " << sweepMilliseconds << " ms/frame, " << static_cast<double>(pairsFound) / (iterations * frameCount) << " pairs/frame\n"
+              << "Nested loop: " << nestedMilliseconds << " ms/frame, " << static_cast<double>(nestedPairsFound) / (iterations * frameCount) << " pairs/frame\n";
+
+    return 0;
+}
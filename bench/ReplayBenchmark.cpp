@@ -0,0 +1,298 @@
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <yaml-cpp/yaml.h>
+#include <opencv2/opencv.hpp>
+
+#include "AllocationCounter.hpp"
+#include "BenchmarkFrames.hpp"
+#include "Config.hpp"
+#include "VisionFrame.hpp"
+#include "VisionPipeline.hpp"
+
+// Replays recorded frames through the whole vision pipeline, in order, on one thread, so it needs no camera
+// The first pass starts from a fresh pipeline, like the robot does, and its per-frame results can be saved or checked
+// against a golden file. Later passes are timed per stage and count heap allocations, which steady-state frames
+// shouldn't make
+// With a detection scale in the config, the frames are also run at full resolution to show what the scale costs in
+// targets found and in horizontal angle
+// Usage: ReplayBenchmark <frame directory | video file> [config file] [iterations] [allocations per frame allowed]
+//                        [--results=file] [--golden=file] [--tolerance=degrees]
+// Exits with 2 when the allocation budget is exceeded and 3 when the results don't match the golden file
+
+class FrameResult
+{
+public:
+    bool foundTarget{false};
+    double centerX{0};
+    double centerY{0};
+    double horizontalAngleError{0};
+};
+
+class Stage
+{
+public:
+    std::string name;
+    void (VisionPipeline::*run)(VisionFrame &);
+    std::vector<double> milliseconds;
+};
+
+double percentile(std::vector<double> samples, double fraction)
+{
+    size_t index{std::min(samples.size() - 1, static_cast<size_t>(fraction * samples.size()))};
+    std::nth_element(samples.begin(), samples.begin() + index, samples.end());
+    return samples.at(index);
+}
+
+void writeResults(std::ostream &out, const std::vector<FrameResult> &results)
+{
+    out << "frame,foundTarget,centerX,centerY,horizontalAngleError\n";
+    for (size_t f{0}; f < results.size(); ++f)
+    {
+        const FrameResult &result{results.at(f)};
+        out << f << ',' << result.foundTarget << ',' << result.centerX << ',' << result.centerY << ',' << result.horizontalAngleError << '\n';
+    }
+}
+
+bool readResults(const std::string &path, std::vector<FrameResult> &results)
+{
+    std::ifstream in{path};
+    if (!in.is_open())
+        return false;
+
+    std::string line;
+    std::getline(in, line);
+    while (std::getline(in, line))
+    {
+        std::istringstream fields{line};
+        FrameResult result;
+        int frameNumber;
+        char comma;
+        if (fields >> frameNumber >> comma >> result.foundTarget >> comma >> result.centerX >> comma >> result.centerY >> comma >> result.horizontalAngleError)
+            results.push_back(result);
+    }
+
+    return true;
+}
+
+// Prints the first few frames that differ and returns how many did
+int compareResults(const std::vector<FrameResult> &results, const std::vector<FrameResult> &golden, double tolerance)
+{
+    int mismatches{0};
+    for (size_t f{0}; f < std::max(results.size(), golden.size()); ++f)
+    {
+        bool matches{f < results.size() && f < golden.size() &&
+                     results.at(f).foundTarget == golden.at(f).foundTarget &&
+                     (!results.at(f).foundTarget || std::abs(results.at(f).horizontalAngleError - golden.at(f).horizontalAngleError) <= tolerance)};
+        if (matches)
+            continue;
+
+        if (++mismatches <= 10)
+        {
+            std::cout << "Frame " << f << ": ";
+            if (f < results.size())
+                std::cout << (results.at(f).foundTarget ? std::to_string(results.at(f).horizontalAngleError) : "no target");
+            else
+                std::cout << "missing";
+            std::cout << " vs golden ";
+            if (f < golden.size())
+                std::cout << (golden.at(f).foundTarget ? std::to_string(golden.at(f).horizontalAngleError) : "no target");
+            else
+                std::cout << "missing";
+            std::cout << '\n';
+        }
+    }
+
+    return mismatches;
+}
+
+// Compares results found with a detection scale against fullResolution, found without one
+void reportAccuracy(const std::vector<FrameResult> &results, const std::vector<FrameResult> &fullResolution, int scale)
+{
+    int fullResolutionTargets{0}, bothFound{0}, onlyScaled{0};
+    double totalError{0}, maxError{0};
+    for (size_t f{0}; f < results.size(); ++f)
+    {
+        const FrameResult &scaled{results.at(f)}, &full{fullResolution.at(f)};
+        fullResolutionTargets += full.foundTarget;
+        if (scaled.foundTarget && !full.foundTarget)
+            ++onlyScaled;
+        if (!scaled.foundTarget || !full.foundTarget)
+            continue;
+
+        double error{std::abs(scaled.horizontalAngleError - full.horizontalAngleError)};
+        totalError += error;
+        maxError = std::max(maxError, error);
+        ++bothFound;
+    }
+
+    std::cout << "Detection scale " << scale << " vs full resolution: found " << bothFound << " of " << fullResolutionTargets
+              << " targets and " << onlyScaled << " more, horizontal angle off by " << (bothFound > 0 ? totalError / bothFound : 0)
+              << " degrees on average and " << maxError << " at most\n";
+}
+
+int main(int argc, char *argv[])
+{
+    std::vector<std::string> arguments;
+    std::string resultsPath, goldenPath;
+    double tolerance{0.01};
+    for (int a{1}; a < argc; ++a)
+    {
+        std::string argument{argv[a]};
+        if (argument.rfind("--results=", 0) == 0)
+            resultsPath = argument.substr(10);
+        else if (argument.rfind("--golden=", 0) == 0)
+            goldenPath = argument.substr(9);
+        else if (argument.rfind("--tolerance=", 0) == 0)
+            tolerance = std::stod(argument.substr(12));
+        else
+            arguments.push_back(argument);
+    }
+
+    if (arguments.empty())
+    {
+        std::cout << "Usage: " << argv[0] << " <frame directory | video file> [config file] [iterations] [allocations per frame allowed]"
+                  << " [--results=file] [--golden=file] [--tolerance=degrees]\n";
+        return 1;
+    }
+
+    std::vector<cv::Mat> frames{loadFrames(arguments.at(0))};
+    if (frames.empty())
+    {
+        std::cout << "Could not load any frames from " << arguments.at(0) << '\n';
+        return 1;
+    }
+
+    VisionConfig visionConfig{};
+    RaspicamConfig raspicamConfig{};
+    YAML::Node yamlConfig{YAML::LoadFile(arguments.size() > 1 ? arguments.at(1) : "resources/config.yaml")};
+    visionConfig.parse(yamlConfig);
+    raspicamConfig.parse(yamlConfig);
+
+    int iterations{arguments.size() > 2 ? std::stoi(arguments.at(2)) : 10};
+    double allocationBudget{arguments.size() > 3 ? std::stod(arguments.at(3)) : -1};
+
+    std::cout << frames.size() << " frames of " << frames.front().cols << 'x' << frames.front().rows << ", " << iterations << " iterations\n";
+
+    ConfigSnapshot<VisionConfig> visionSnapshot;
+    visionSnapshot.publish(visionConfig);
+    ConfigSnapshot<RaspicamConfig> raspicamSnapshot;
+    raspicamSnapshot.publish(raspicamConfig);
+    VisionPipeline pipeline{visionSnapshot, raspicamSnapshot};
+    VisionFrame frame;
+
+    // Also grows every buffer to its working size
+    std::vector<FrameResult> results;
+    for (const cv::Mat &recorded : frames)
+    {
+        frame.frame = recorded;
+        pipeline.process(frame);
+        results.push_back(FrameResult{frame.foundTarget, frame.centerX, frame.centerY, frame.horizontalAngleError});
+    }
+
+    if (resultsPath.empty())
+    {
+        writeResults(std::cout, results);
+    }
+    else
+    {
+        std::ofstream resultsFile{resultsPath};
+        writeResults(resultsFile, results);
+    }
+
+    // The same steps segment() and findTargets() take, in the same order
+    std::vector<Stage> stages{Stage{"threshold", &VisionPipeline::threshold},
+                              Stage{"removeNoise", &VisionPipeline::removeNoise},
+                              Stage{"findContours", &VisionPipeline::findContours},
+                              Stage{"pairContours", &VisionPipeline::pairContours}};
+    std::vector<double> totalMilliseconds;
+
+    size_t processed{iterations * frames.size()};
+    for (Stage &stage : stages)
+        stage.milliseconds.reserve(processed);
+    totalMilliseconds.reserve(processed);
+
+    int targets{0};
+    size_t allocationsBefore{allocationCounter::count().load()};
+    for (int i{0}; i < iterations; ++i)
+    {
+        for (const cv::Mat &recorded : frames)
+        {
+            // Assigning a Mat header only bumps a reference count
+            frame.frame = recorded;
+
+            int64 frameStart{cv::getTickCount()};
+            for (Stage &stage : stages)
+            {
+                int64 start{cv::getTickCount()};
+                (pipeline.*stage.run)(frame);
+                stage.milliseconds.push_back((cv::getTickCount() - start) * 1000.0 / cv::getTickFrequency());
+            }
+            totalMilliseconds.push_back((cv::getTickCount() - frameStart) * 1000.0 / cv::getTickFrequency());
+
+            targets += frame.foundTarget;
+        }
+    }
+    size_t allocations{allocationCounter::count().load() - allocationsBefore};
+
+    for (const Stage &stage : stages)
+        std::cout << stage.name << ": p50 " << percentile(stage.milliseconds, 0.5) << " ms, p99 " << percentile(stage.milliseconds, 0.99) << " ms\n";
+
+    double meanMilliseconds{0};
+    for (double milliseconds : totalMilliseconds)
+        meanMilliseconds += milliseconds;
+    meanMilliseconds /= processed;
+
+    double allocationsPerFrame{static_cast<double>(allocations) / processed};
+    std::cout << "VisionPipeline: p50 " << percentile(totalMilliseconds, 0.5) << " ms, p99 " << percentile(totalMilliseconds, 0.99) << " ms, "
+              << meanMilliseconds << " ms/frame, " << 1000 / meanMilliseconds << " fps, "
+              << static_cast<double>(targets) / processed * 100 << "% frames with a target, "
+              << allocationsPerFrame << " heap allocations/frame\n";
+
+    if (visionConfig.detectionScale.value > 1)
+    {
+        VisionConfig fullResolutionConfig{visionConfig};
+        fullResolutionConfig.detectionScale.value = 1;
+        ConfigSnapshot<VisionConfig> fullResolutionSnapshot;
+        fullResolutionSnapshot.publish(fullResolutionConfig);
+        VisionPipeline fullResolutionPipeline{fullResolutionSnapshot, raspicamSnapshot};
+
+        std::vector<FrameResult> fullResolutionResults;
+        for (const cv::Mat &recorded : frames)
+        {
+            frame.frame = recorded;
+            fullResolutionPipeline.process(frame);
+            fullResolutionResults.push_back(FrameResult{frame.foundTarget, frame.centerX, frame.centerY, frame.horizontalAngleError});
+        }
+
+        reportAccuracy(results, fullResolutionResults, visionConfig.detectionScale.value);
+    }
+
+    int status{0};
+    if (allocationBudget >= 0 && allocationsPerFrame > allocationBudget)
+    {
+        std::cout << "Over the allocation budget of " << allocationBudget << "/frame\n";
+        status = 2;
+    }
+
+    if (!goldenPath.empty())
+    {
+        std::vector<FrameResult> golden;
+        if (!readResults(goldenPath, golden))
+        {
+            std::cout << "Could not read golden results from " << goldenPath << '\n';
+            return 1;
+        }
+
+        int mismatches{compareResults(results, golden, tolerance)};
+        std::cout << mismatches << " of " << results.size() << " frames differ from " << goldenPath << '\n';
+        if (mismatches != 0)
+            status = 3;
+    }
+
+    return status;
+}
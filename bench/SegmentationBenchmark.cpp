@@ -0,0 +1,97 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <functional>
+#include <yaml-cpp/yaml.h>
+#include <opencv2/opencv.hpp>
+
+#include "BenchmarkFrames.hpp"
+#include "ColorLookupTable.hpp"
+#include "HSVThreshold.hpp"
+
+// Compares the segmentation paths on recorded frames
+// Usage: SegmentationBenchmark <frame directory | video file> [config file] [iterations]
+
+// Runs segment over every frame iterations times and prints the mean time and the share of pixels disagreeing with reference
+void benchmark(const std::string &name, const std::vector<cv::Mat> &frames, const std::vector<cv::Mat> &reference, int iterations,
+               const std::function<void(const cv::Mat &, cv::Mat &)> &segment)
+{
+    cv::Mat mask;
+    int64 ticks{0};
+    for (int i{0}; i < iterations; ++i)
+    {
+        for (const cv::Mat &frame : frames)
+        {
+            int64 start{cv::getTickCount()};
+            segment(frame, mask);
+            ticks += cv::getTickCount() - start;
+        }
+    }
+
+    double mismatched{0}, total{0};
+    for (size_t f{0}; f < frames.size(); ++f)
+    {
+        segment(frames.at(f), mask);
+
+        cv::Mat difference;
+        cv::compare(mask, reference.at(f), difference, cv::CMP_NE);
+        mismatched += cv::countNonZero(difference);
+        total += mask.total();
+    }
+
+    double milliseconds{ticks * 1000.0 / cv::getTickFrequency() / (iterations * frames.size())};
+    std::cout << name << ": " << milliseconds << " ms/frame, " << mismatched / total * 100 << "% pixels differ\n";
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        std::cout << "Usage: " << argv[0] << " <frame directory | video file> [config file] [iterations]\n";
+        return 1;
+    }
+
+    std::vector<cv::Mat> frames{loadFrames(argv[1])};
+    if (frames.empty())
+    {
+        std::cout << "Could not load any frames from " << argv[1] << '\n';
+        return 1;
+    }
+
+    YAML::Node vision{YAML::LoadFile(argc > 2 ? argv[2] : "resources/config.yaml")["vision"]};
+    int iterations{argc > 3 ? std::stoi(argv[3]) : 10};
+
+    HSVThreshold threshold{vision["lowHue"].as<int>(), vision["lowSaturation"].as<int>(), vision["lowValue"].as<int>(),
+                           vision["highHue"].as<int>(), vision["highSaturation"].as<int>(), vision["highValue"].as<int>()};
+
+    std::cout << frames.size() << " frames of " << frames.front().cols << 'x' << frames.front().rows << ", " << iterations << " iterations\n";
+
+    auto cvtColorInRange = [&threshold](const cv::Mat &frame, cv::Mat &mask) {
+        cv::Mat hsv;
+        cv::cvtColor(frame, hsv, cv::COLOR_BGR2HSV);
+        cv::inRange(hsv, cv::Scalar(threshold.lowHue, threshold.lowSaturation, threshold.lowValue),
+                    cv::Scalar(threshold.highHue, threshold.highSaturation, threshold.highValue), mask);
+    };
+
+    std::vector<cv::Mat> reference;
+    for (const cv::Mat &frame : frames)
+    {
+        reference.push_back(cv::Mat{});
+        cvtColorInRange(frame, reference.back());
+    }
+
+    ColorLookupTable lookupTable;
+    int64 buildStart{cv::getTickCount()};
+    lookupTable.update(threshold);
+    std::cout << "Lookup table build: " << (cv::getTickCount() - buildStart) * 1000.0 / cv::getTickFrequency() << " ms\n";
+
+    benchmark("cvtColor + inRange", frames, reference, iterations, cvtColorInRange);
+    benchmark("HSVThreshold", frames, reference, iterations, [&threshold](const cv::Mat &frame, cv::Mat &mask) {
+        threshold.apply(frame, mask);
+    });
+    benchmark("ColorLookupTable", frames, reference, iterations, [&lookupTable](const cv::Mat &frame, cv::Mat &mask) {
+        lookupTable.apply(frame, mask);
+    });
+
+    return 0;
+}
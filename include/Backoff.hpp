@@ -0,0 +1,22 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+
+// Waits longer after every failure, up to a limit, for retrying things like reopening a camera that isn't there
+class Backoff
+{
+public:
+    Backoff(std::chrono::milliseconds initialDelay, std::chrono::milliseconds maxDelay);
+
+    // Sleeps for the current delay, waking early if stopFlag is set, then doubles it
+    void wait(const std::atomic<bool> &stopFlag);
+
+    // Call once whatever was being retried works again
+    void reset();
+
+private:
+    std::chrono::milliseconds mInitialDelay;
+    std::chrono::milliseconds mMaxDelay;
+    std::chrono::milliseconds mDelay;
+};
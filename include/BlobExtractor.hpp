@@ -0,0 +1,76 @@
+#pragma once
+
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+// Statistics for every blob found by BlobExtractor, one array per statistic indexed by blob
+class BlobStats
+{
+public:
+    // Pixel count
+    std::vector<int> area;
+
+    // Inclusive bounding box
+    std::vector<int> left;
+    std::vector<int> top;
+    std::vector<int> right;
+    std::vector<int> bottom;
+
+    // Raw image moments about the frame origin
+    std::vector<double> m10;
+    std::vector<double> m01;
+    std::vector<double> m20;
+    std::vector<double> m11;
+    std::vector<double> m02;
+
+    // The blob's runs are BlobExtractor::getRuns()[firstRun, firstRun + runCount)
+    std::vector<int> firstRun;
+    std::vector<int> runCount;
+
+    int size() const
+    {
+        return area.size();
+    }
+
+    void resize(int blobs);
+};
+
+// A horizontal stretch of set pixels, inclusive at both ends
+class Run
+{
+public:
+    int y;
+    int start;
+    int end;
+    int blob;
+};
+
+// Finds 8-connected blobs of nonzero pixels in a binary mask in a single pass over its rows
+// Rows are split into runs, runs that touch the previous row's are merged with union-find, and the statistics are
+// gathered per run, so no label image is ever written
+class BlobExtractor
+{
+public:
+    // offset is added to every coordinate, for masks that only cover part of the frame
+    void extract(const cv::Mat &mask, cv::Point offset = cv::Point{0, 0});
+
+    const BlobStats &getStats() const;
+
+    // Runs grouped by blob, in row order within each blob
+    const std::vector<Run> &getRuns() const;
+
+    // Appends the outer edge of a blob to outline: the leftmost pixel of each row from top to bottom, then the
+    // rightmost pixel of each row from bottom to top. That's at most two points per row
+    void appendOutline(int blob, std::vector<cv::Point> &outline) const;
+
+private:
+    // Kept between frames so steady-state extraction doesn't allocate
+    std::vector<Run> mScanRuns;
+    std::vector<int> mParents;
+    std::vector<int> mBlobOfRoot;
+    std::vector<Run> mRuns;
+    BlobStats mStats;
+
+    int findRoot(int run);
+    void unite(int a, int b);
+};
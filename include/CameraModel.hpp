@@ -0,0 +1,32 @@
+#pragma once
+
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+#include "Config.hpp"
+
+// The camera's intrinsics and lens distortion, for turning where something is in the frame into the direction it was
+// seen in. Only the few points that are measured get undistorted, never the whole frame
+class CameraModel
+{
+public:
+    // Takes a new calibration, which is for config.width x config.height
+    void setConfig(const RaspicamConfig &config);
+
+    // Scales the calibration to frames of size
+    void setFrameSize(cv::Size size);
+
+    // Where each of points would be seen on a plane one unit in front of the camera, x to the right and y down
+    void toRays(const std::vector<cv::Point2f> &points, std::vector<cv::Point2f> &rays) const;
+
+    // Degrees right of straight ahead
+    static double getHorizontalAngle(const cv::Point2f &ray);
+
+private:
+    RaspicamConfig mConfig;
+    cv::Size mFrameSize;
+
+    cv::Matx33d mCameraMatrix{cv::Matx33d::eye()};
+    cv::Matx<double, 1, 5> mDistortion;
+    bool mDistorted{false};
+};
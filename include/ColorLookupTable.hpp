@@ -0,0 +1,33 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <opencv2/opencv.hpp>
+
+#include "HSVThreshold.hpp"
+
+// Segments BGR frames with a precomputed 64x64x64 color cube instead of per-pixel HSV math
+// Each channel is quantized to 6 bits and every cell holds one bit, so the whole table is 32KB and stays in L1 cache
+class ColorLookupTable
+{
+public:
+    static constexpr int bitsPerChannel{6};
+    static constexpr int cellsPerChannel{1 << bitsPerChannel};
+    static constexpr int cells{cellsPerChannel * cellsPerChannel * cellsPerChannel};
+
+    ColorLookupTable();
+
+    // Rebuilds the table if threshold differs from the one it was last built from
+    // Returns whether a rebuild happened
+    bool update(const HSVThreshold &threshold);
+
+    // Writes 255 to mask for every pixel of bgrFrame whose cell is within the thresholds and 0 otherwise
+    void apply(const cv::Mat &bgrFrame, cv::Mat &mask) const;
+
+private:
+    std::array<uint8_t, cells / 8> mTable{};
+    HSVThreshold mThreshold;
+    bool mBuilt{false};
+
+    void rebuild(const HSVThreshold &threshold);
+};
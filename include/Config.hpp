@@ -1,6 +1,7 @@
 #pragma once
 
 #include <vector>
+#include <yaml-cpp/yaml.h>
 
 #include "Setting.hpp"
 
@@ -21,6 +22,17 @@ public:
     {
         return mTag;
     }
+
+    // Reads every setting from yaml, keeping the current value of any setting it doesn't contain
+    void parse(YAML::Node yaml);
+
+    // Writes every setting into yaml under this config's tag
+    void emit(YAML::Node &yaml);
+
+    // Derived configs copy through these, since copying settings itself would leave the copy pointing at the
+    // original's settings. Both configs must be the same type, so their settings line up
+    void copyValues(const Config &other);
+    bool hasSameValues(const Config &other) const;
 };
 
 class SystemConfig : public Config
@@ -29,16 +41,44 @@ public:
     BoolSetting verbose{"verbose"};
     BoolSetting tuning{"tuning"};
     IntSetting videoPort{"videoPort"};
+    IntSetting streamScale{"streamScale"};
     IntSetting robotPort{"robotPort"};
     IntSetting receivePort{"receivePort"};
+    BoolSetting metrics{"metrics"};
+    StringSetting robotAddress{"robotAddress"};
+    IntSetting robotRate{"robotRate"};
 
     SystemConfig() : Config("system")
     {
         settings.push_back(std::move(&verbose));
         settings.push_back(std::move(&tuning));
         settings.push_back(std::move(&videoPort));
+        settings.push_back(std::move(&streamScale));
         settings.push_back(std::move(&robotPort));
         settings.push_back(std::move(&receivePort));
+        settings.push_back(std::move(&metrics));
+        settings.push_back(std::move(&robotAddress));
+        settings.push_back(std::move(&robotRate));
+
+        // Point this at localhost to watch the packets with RobotReceiver
+        robotAddress.value = "10.28.51.2";
+
+        // Streams at full resolution unless asked to divide it down
+        streamScale.value = 1;
+
+        // Packets per second predicted between frames, on top of one per frame. 0 only sends one per frame
+        robotRate.value = 0;
+    }
+
+    SystemConfig(const SystemConfig &other) : SystemConfig()
+    {
+        copyValues(other);
+    }
+
+    SystemConfig &operator=(const SystemConfig &other)
+    {
+        copyValues(other);
+        return *this;
     }
 };
 
@@ -56,6 +96,12 @@ public:
     IntSetting maxArea{"maxArea"};
     IntSetting minRotation{"minRotation"};
     IntSetting allowableError{"allowableError"};
+    IntSetting trackingMisses{"trackingMisses"};
+    IntSetting filterAlpha{"filterAlpha"};
+    IntSetting filterBeta{"filterBeta"};
+    IntSetting filterDropout{"filterDropout"};
+    IntSetting detectionScale{"detectionScale"};
+    IntSetting stripes{"stripes"};
 
     VisionConfig() : Config("vision")
     {
@@ -70,6 +116,37 @@ public:
         settings.push_back(std::move(&maxArea));
         settings.push_back(std::move(&minRotation));
         settings.push_back(std::move(&allowableError));
+        settings.push_back(std::move(&trackingMisses));
+        settings.push_back(std::move(&filterAlpha));
+        settings.push_back(std::move(&filterBeta));
+        settings.push_back(std::move(&filterDropout));
+        settings.push_back(std::move(&detectionScale));
+        settings.push_back(std::move(&stripes));
+
+        // How much of each new measurement's angle and speed is trusted, in percent, and how many milliseconds the
+        // estimate outlives the last sighting. A dropout of 0 stops predictions
+        filterAlpha.value = 60;
+        filterBeta.value = 20;
+        filterDropout.value = 500;
+
+        // Blobs are first looked for in the frame shrunk by this much, 2 or 4, and only the regions around them are
+        // searched at full resolution. 1 searches the whole frame
+        detectionScale.value = 1;
+
+        // Each frame is split into this many horizontal stripes that are segmented and labelled on every core at once
+        // 1 does it all on one thread
+        stripes.value = 1;
+    }
+
+    VisionConfig(const VisionConfig &other) : VisionConfig()
+    {
+        copyValues(other);
+    }
+
+    VisionConfig &operator=(const VisionConfig &other)
+    {
+        copyValues(other);
+        return *this;
     }
 };
 
@@ -90,6 +167,17 @@ public:
         settings.push_back(std::move(&exposure));
         settings.push_back(std::move(&exposureAuto));
     }
+
+    UvccamConfig(const UvccamConfig &other) : UvccamConfig()
+    {
+        copyValues(other);
+    }
+
+    UvccamConfig &operator=(const UvccamConfig &other)
+    {
+        copyValues(other);
+        return *this;
+    }
 };
 
 class RaspicamConfig : public Config
@@ -101,6 +189,15 @@ public:
     IntSetting shutterSpeed{"shutterSpeed"};
     IntSetting exposureMode{"exposureMode"};
     IntSetting horizontalFov{"horizontalFov"};
+    DoubleSetting focalLengthX{"focalLengthX"};
+    DoubleSetting focalLengthY{"focalLengthY"};
+    DoubleSetting principalPointX{"principalPointX"};
+    DoubleSetting principalPointY{"principalPointY"};
+    DoubleSetting distortionK1{"distortionK1"};
+    DoubleSetting distortionK2{"distortionK2"};
+    DoubleSetting distortionP1{"distortionP1"};
+    DoubleSetting distortionP2{"distortionP2"};
+    DoubleSetting distortionK3{"distortionK3"};
 
     RaspicamConfig() : Config("raspicam")
     {
@@ -110,5 +207,44 @@ public:
         settings.push_back(std::move(&shutterSpeed));
         settings.push_back(std::move(&exposureMode));
         settings.push_back(std::move(&horizontalFov));
+        settings.push_back(std::move(&focalLengthX));
+        settings.push_back(std::move(&focalLengthY));
+        settings.push_back(std::move(&principalPointX));
+        settings.push_back(std::move(&principalPointY));
+        settings.push_back(std::move(&distortionK1));
+        settings.push_back(std::move(&distortionK2));
+        settings.push_back(std::move(&distortionP1));
+        settings.push_back(std::move(&distortionP2));
+        settings.push_back(std::move(&distortionK3));
+
+        // Intrinsics in pixels at width x height and OpenCV's distortion coefficients, as calibrateCamera() gives them
+        // A focal length of 0 is worked out from horizontalFov, and a principal point of 0 is the middle of the frame
+        focalLengthX.value = 0;
+        focalLengthY.value = 0;
+        principalPointX.value = 0;
+        principalPointY.value = 0;
+        distortionK1.value = 0;
+        distortionK2.value = 0;
+        distortionP1.value = 0;
+        distortionP2.value = 0;
+        distortionK3.value = 0;
+    }
+
+    RaspicamConfig(const RaspicamConfig &other) : RaspicamConfig()
+    {
+        copyValues(other);
+    }
+
+    RaspicamConfig &operator=(const RaspicamConfig &other)
+    {
+        copyValues(other);
+        return *this;
+    }
+
+    // Whether other would open the camera the same way. The field of view and calibration are read as frames go
+    bool hasSameCameraSettings(const RaspicamConfig &other) const
+    {
+        return width.value == other.width.value && height.value == other.height.value && fps.value == other.fps.value &&
+               shutterSpeed.value == other.shutterSpeed.value && exposureMode.value == other.exposureMode.value;
     }
 };
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <memory>
+
+// Publishes immutable copies of a config so other threads can read it without locks or torn values
+// Readers keep the copy they got for as long as they hold it, so a publish never changes settings under a reader;
+// it only decides what the next get() returns
+template <typename T>
+class ConfigSnapshot
+{
+public:
+    // Copies config, so it can go on being changed afterwards
+    void publish(const T &config)
+    {
+        std::shared_ptr<const T> snapshot{std::make_shared<T>(config)};
+        std::atomic_store(&mSnapshot, snapshot);
+    }
+
+    // Null until the first publish
+    std::shared_ptr<const T> get() const
+    {
+        return std::atomic_load(&mSnapshot);
+    }
+
+private:
+    std::shared_ptr<const T> mSnapshot;
+};
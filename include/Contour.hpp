@@ -6,7 +6,10 @@
 class Contour
 {
 public:
-    std::vector<cv::Point> pointsVector;
+    // A view of the outline, whose points belong to the frame's contour arena and must outlive the contour
+    const cv::Point *points{nullptr};
+    int pointCount{0};
+
     cv::Rect boundingBox;
     cv::RotatedRect rotatedBoundingBox;
     cv::Point2f rotatedBoundingBoxPoints[4];
@@ -14,6 +17,9 @@ public:
     double angle;
 
     Contour();
-    Contour(std::vector<cv::Point> &pointsVector);
+    Contour(const cv::Point *points, int pointCount);
+
+    // Measures the outline and checks it could be a strip, cheapest checks first, so most blobs are rejected before a
+    // rectangle is ever fitted. angle is the long axis from horizontal, positive leaning right
     bool isValid(double minArea, double maxArea, double minRotation, int error);
 };
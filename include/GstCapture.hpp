@@ -0,0 +1,81 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <gst/gst.h>
+#include <gst/app/gstappsink.h>
+#include <opencv2/opencv.hpp>
+
+// Captures frames from a GStreamer pipeline through an appsink without copying them
+// Each frame is a cv::Mat header over the mapped GstBuffer, so no conversion or copy happens on our side
+// Any source works as long as it can be converted to the format asked for, e.g. rpicamsrc, v4l2src, videotestsrc or
+// filesrc ! decodebin
+class GstCapture
+{
+public:
+    enum Format
+    {
+        bgr,
+        // Planar, as a single channel Mat of height * 3 / 2 rows
+        i420,
+        // Compressed frames straight from the source, as a single row Mat of bytes
+        jpeg
+    };
+
+    // Holds one mapped GstBuffer, in the capture's format
+    // frame is read-only and stays valid until the buffer is released or read into again
+    // The upstream element can't reuse the memory while it's held, so only keep as many of these as the pipeline needs
+    class Buffer
+    {
+    public:
+        cv::Mat frame;
+
+        // When the sensor captured the frame, from the buffer's PTS, moved onto steady_clock
+        std::chrono::steady_clock::time_point captureTime;
+
+        Buffer();
+        ~Buffer();
+        Buffer(const Buffer &) = delete;
+        Buffer &operator=(const Buffer &) = delete;
+
+        void release();
+
+    private:
+        friend class GstCapture;
+
+        GstSample *mSample{nullptr};
+        GstBuffer *mBuffer{nullptr};
+        GstMapInfo mMap;
+    };
+
+    // source is a gst-launch description of everything before the appsink, e.g. "videotestsrc ! video/x-raw,width=320"
+    GstCapture(std::string source, Format format = bgr);
+    ~GstCapture();
+
+    bool open();
+    bool isOpened();
+    Format getFormat();
+    void release();
+
+    // Waits up to timeout for the newest frame and maps it into buffer
+    // Frames that arrived while we were busy are dropped by the appsink, so this never returns a stale backlog
+    // On failure buffer keeps whatever it held before
+    bool read(Buffer &buffer, std::chrono::milliseconds timeout);
+
+    // Whether the source has run out of frames, e.g. the end of a file
+    bool isEndOfStream();
+
+    // Whether the pipeline hit an error or ran out of frames, so it has to be released and opened again
+    // Only looks at messages already posted, so it's cheap to call whenever a read times out
+    bool hasStopped();
+
+private:
+    std::string mSource;
+    Format mFormat;
+    GstElement *mPipeline{nullptr};
+    GstElement *mSink{nullptr};
+
+    // An empty Mat if the sample isn't laid out the way mFormat needs
+    cv::Mat wrapFrame(GstSample *sample, const GstMapInfo &map);
+    std::chrono::steady_clock::time_point getCaptureTime(GstBuffer *gstBuffer);
+};
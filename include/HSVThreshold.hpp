@@ -0,0 +1,28 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+
+// Thresholds a BGR frame straight into a binary mask in a single pass
+// Equivalent to cv::cvtColor(COLOR_BGR2HSV) followed by cv::inRange, but never materializes the HSV frame
+class HSVThreshold
+{
+public:
+    int lowHue{0};
+    int lowSaturation{0};
+    int lowValue{0};
+    int highHue{255};
+    int highSaturation{255};
+    int highValue{255};
+
+    HSVThreshold();
+    HSVThreshold(int lowHue, int lowSaturation, int lowValue, int highHue, int highSaturation, int highValue);
+
+    // Whether a single BGR pixel falls within the thresholds
+    bool contains(int blue, int green, int red) const;
+
+    // Writes 255 to mask for every pixel of bgrFrame within the thresholds and 0 otherwise
+    void apply(const cv::Mat &bgrFrame, cv::Mat &mask) const;
+
+private:
+    void applyRow(const uchar *bgrRow, uchar *maskRow, int width) const;
+};
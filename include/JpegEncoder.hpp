@@ -0,0 +1,50 @@
+#pragma once
+
+#include <csetjmp>
+#include <cstdio>
+#include <vector>
+#include <jpeglib.h>
+#include <opencv2/opencv.hpp>
+
+// Encodes JPEGs with libjpeg(-turbo) directly, reusing one compressor and the output buffer between frames
+// BGR is handed to libjpeg-turbo as is, grayscale is encoded as a single channel, and I420 frames go through the
+// raw data path, so none of them are converted on our side
+class JpegEncoder
+{
+public:
+    JpegEncoder();
+    ~JpegEncoder();
+    JpegEncoder(const JpegEncoder &) = delete;
+    JpegEncoder &operator=(const JpegEncoder &) = delete;
+
+    // image is CV_8UC3 BGR or CV_8UC1 grayscale. Returns false if it's neither or libjpeg fails
+    bool encode(const cv::Mat &image, int quality, std::vector<uchar> &jpeg);
+
+    // i420 is a CV_8UC1 Mat of height * 3 / 2 rows: the Y plane, then the quarter size U and V planes
+    bool encodeI420(const cv::Mat &i420, int quality, std::vector<uchar> &jpeg);
+
+private:
+    // Extends libjpeg's error manager so errors jump back to us instead of exiting the program
+    class ErrorManager
+    {
+    public:
+        jpeg_error_mgr manager;
+        std::jmp_buf jump;
+    };
+
+    // Extends libjpeg's destination manager to write into a vector that keeps its capacity between frames
+    class Destination
+    {
+    public:
+        jpeg_destination_mgr manager;
+        std::vector<uchar> *output{nullptr};
+    };
+
+    jpeg_compress_struct mCompress;
+    ErrorManager mError;
+    Destination mDestination;
+
+    cv::Mat mConverted;
+
+    void start(int width, int height, J_COLOR_SPACE colorSpace, int components, int quality, std::vector<uchar> &jpeg);
+};
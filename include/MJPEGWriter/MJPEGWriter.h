@@ -1,192 +1,162 @@
-#include <unistd.h>
-#include <sys/time.h>
-#include <sys/types.h>
-#include <sys/socket.h>
-#include <sys/signal.h>
-#include <netdb.h>
-#include <netinet/in.h>
-#include <arpa/inet.h>
-#define PORT        unsigned short
-#define SOCKET    int
-#define HOSTENT  struct hostent
-#define SOCKADDR    struct sockaddr
-#define SOCKADDR_IN  struct sockaddr_in
-#define ADDRPOINTER  unsigned int*
-#define INVALID_SOCKET -1
-#define SOCKET_ERROR   -1
-#define TIMEOUT_M       200000
-#define NUM_CONNECTIONS 10
-
-#include <pthread.h>
-#include <iostream>
-#include <stdio.h>
-#include <string.h>
-#include "opencv2/opencv.hpp"
-
-using namespace cv;
-using namespace std;
-
-struct clientFrame {
-    uchar* outbuf;
-    int outlen;
-    int client;
-};
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+#include "JpegEncoder.hpp"
+#include "Metrics.hpp"
+
+// Serves the latest frame written to it as an MJPEG stream over HTTP, to any number of clients
+// A single thread drives all sockets with epoll without ever blocking on one, and only wakes for sockets, new frames
+// and clients' frame rate limits. A client that can't keep up finishes the frame it's on and then skips to the
+// newest one, so a slow viewer only slows itself down
+// Clients can ask for a lower frame rate and JPEG quality in the query string, e.g. http://host:port/?fps=5&q=50
+// Each frame is only encoded once per quality anyone is watching at, and only once someone is due to be sent it
+class MJPEGWriter
+{
+public:
+    MJPEGWriter(int port = 0);
+    ~MJPEGWriter();
 
-struct clientPayload {
-    void* context;
-    clientFrame cf;
-};
+    // Starts listening and serving on its own thread
+    void start();
 
-class MJPEGWriter{
-    SOCKET sock;
-    fd_set master;
-    int timeout;
-    int quality; // jpeg compression [1..100]
-    std::vector<int> clients;
-    pthread_t thread_listen, thread_write;
-    pthread_mutex_t mutex_client = PTHREAD_MUTEX_INITIALIZER;
-    pthread_mutex_t mutex_cout = PTHREAD_MUTEX_INITIALIZER;
-    pthread_mutex_t mutex_writer = PTHREAD_MUTEX_INITIALIZER;
-    Mat lastFrame;
-    int port;
-
-    // Added
-    bool stopFlag{false};
-
-    int _write(int sock, char *s, int len)
-    {
-        if (len < 1) { len = strlen(s); }
-        {
-        	try
-        	{
-        		int retval = ::send(sock, s, len, 0x4000);
-        		return retval;
-        	}
-        	catch (int e)
-        	{
-        		cout << "An exception occurred. Exception Nr. " << e << '\n';
-        	}
-        }
-        return -1;
-    }
-    
-    int _read(int socket, char* buffer)
-    {
-        int result;
-        result = recv(socket, buffer, 4096, MSG_PEEK);
-        if (result < 0 )
-        {
-            cout << "An exception occurred. Exception Nr. " << result << '\n';
-            return result;
-        }
-        string s = buffer;
-        buffer = (char*) s.substr(0, (int) result).c_str();
-        return result;
-    }
+    // Disconnects every client and stops listening
+    void stop();
 
-    static void* listen_Helper(void* context)
-    {
-        ((MJPEGWriter *)context)->Listener();
-        return NULL;
-    }
+    bool isOpened();
 
-    static void* writer_Helper(void* context)
-    {
-        ((MJPEGWriter *)context)->Writer();
-        return NULL;
-    }
+    // Sets the frame to be served next, either BGR or grayscale. Grayscale frames are encoded as a single channel
+    // Copies frame into a buffer that's handed over rather than cloned, so once the buffers have grown to the frame
+    // size this never allocates
+    // Several threads can write, e.g. one per camera, and whichever wrote last is served
+    void write(const cv::Mat &frame);
 
-    static void* clientWrite_Helper(void* payload)
-    {
-        void* ctx = ((clientPayload *)payload)->context;
-        struct clientFrame cf = ((clientPayload *)payload)->cf;
-        ((MJPEGWriter *)ctx)->ClientWrite(cf);
-        return NULL;
-    }
+    // Same as write(), for an I420 frame of height * 3 / 2 rows, which is encoded without converting it to BGR
+    void writeI420(const cv::Mat &frame);
 
-public:
+    // Same as write(), for a frame that's already a JPEG, as a single row of bytes. It's served as it is, so neither the
+    // scale nor the quality clients ask for apply
+    void writeJpeg(const cv::Mat &jpeg);
 
-    MJPEGWriter(int port = 0)
-        : sock(INVALID_SOCKET)
-        , timeout(TIMEOUT_M)
-        , quality(90)
-	, port(port)
-    {
-        signal(SIGPIPE, SIG_IGN);
-        FD_ZERO(&master);
-        // if (port)
-        //     open(port);
-    }
+    // Serves frames at 1 / divisor of the size they're written at, which cuts encode time and bandwidth
+    void setScale(int divisor);
 
-    ~MJPEGWriter()
-    {
-        release();
-    }
+    // Records encode time and size into metrics, or stops recording if it's null
+    void setMetrics(Metrics *metrics);
 
-    bool release()
+private:
+    enum FrameFormat
     {
-        if (sock != INVALID_SOCKET)
-            shutdown(sock, 2);
-        sock = (INVALID_SOCKET);
-        return false;
-    }
-
-    bool open()
+        image,
+        i420,
+        passthrough
+    };
+
+    // One encoded frame and its multipart header, which go out together in a single send
+    // Clients hold a reference until they've sent all of it, and slots nobody holds are reused for the next frame
+    class EncodedFrame
     {
-        sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
-
-        // Lets us immediately rebind to the port after termination
-        int reuseAddress{1};
-        setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, (char*) &reuseAddress, sizeof(reuseAddress));
-
-        SOCKADDR_IN address;
-        address.sin_addr.s_addr = INADDR_ANY;
-        address.sin_family = AF_INET;
-        address.sin_port = htons(port);
-        
-        if (::bind(sock, (SOCKADDR*)&address, sizeof(SOCKADDR_IN)) == SOCKET_ERROR)
-        {
-            cerr << "error : couldn't bind sock " << sock << " to port " << port << "!" << endl;
-            return release();
-        }
-        if (listen(sock, NUM_CONNECTIONS) == SOCKET_ERROR)
+    public:
+        int generation{0};
+        int quality{0};
+        std::string header;
+        std::vector<uchar> jpeg;
+
+        size_t size() const
         {
-            cerr << "error : couldn't listen on sock " << sock << " on port " << port << " !" << endl;
-            return release();
+            return header.size() + jpeg.size();
         }
-        FD_SET(sock, &master);
-        return true;
-    }
+    };
 
-    bool isOpened()
+    class Client
     {
-        return sock != INVALID_SOCKET;
-    }
-
-    void start(){
-        pthread_mutex_lock(&mutex_writer);
-        pthread_create(&thread_listen, NULL, this->listen_Helper, this);
-        pthread_create(&thread_write, NULL, this->writer_Helper, this);
-    }
-
-    void stop(){
-        stopFlag = true;
-    	this->release();
-        pthread_join(thread_listen, NULL);
-        pthread_join(thread_write, NULL);
-    }
-
-    void write(Mat frame){
-    	pthread_mutex_lock(&mutex_writer);
-    	if(!frame.empty()){
-    		lastFrame.release();
-    		lastFrame = frame.clone();
-    	}
-    	pthread_mutex_unlock(&mutex_writer);
-    }
-
-private:
-    void Listener();
-    void Writer();
-    void ClientWrite(clientFrame &cf);
+    public:
+        int socket{-1};
+
+        // Until the blank line ending the request arrives, nothing is streamed
+        std::string request;
+        bool streaming{false};
+
+        // From the query string
+        int quality{0};
+        std::chrono::steady_clock::duration frameInterval{0};
+
+        // What's being sent and how far along it is. The response header goes first, then frames
+        std::string response;
+        std::shared_ptr<EncodedFrame> frame;
+        size_t sent{0};
+
+        int lastGeneration{0};
+        std::chrono::steady_clock::time_point nextFrameTime;
+
+        // Whether epoll is watching for the socket to become writable
+        bool waitingToWrite{false};
+    };
+
+    int mPort;
+    int mQuality{90};
+    std::atomic<int> mScale{1};
+    std::atomic<Metrics *> mMetrics{nullptr};
+    JpegEncoder mEncoder;
+
+    int mListenSocket{-1};
+    int mEpoll{-1};
+
+    // Written to wake the thread for a new frame or to stop
+    int mWakeEvent{-1};
+
+    std::thread mThread;
+    std::atomic<bool> mStopFlag{false};
+
+    // Triple buffered: write() fills mBackFrame and swaps it with mMiddleFrame, and the serving thread swaps
+    // mMiddleFrame with mFrontFrame whenever there's a newer one. Only the swaps are locked
+    // Each frame's format travels with it. Writers take turns at the back buffer under mWriteMutex
+    std::mutex mWriteMutex;
+    std::mutex mFrameMutex;
+    cv::Mat mBackFrame;
+    FrameFormat mBackFormat{image};
+    cv::Mat mMiddleFrame;
+    FrameFormat mMiddleFormat{image};
+    int mMiddleGeneration{0};
+    cv::Mat mFrontFrame;
+    FrameFormat mFrontFormat{image};
+    int mFrontGeneration{0};
+
+    std::vector<std::unique_ptr<Client>> mClients;
+    std::vector<std::shared_ptr<EncodedFrame>> mFrameSlots;
+
+    // The newest frame encoded at each quality being watched
+    std::vector<std::shared_ptr<EncodedFrame>> mNewestFrames;
+
+    bool open();
+    void release();
+    void run();
+
+    // Hands the back buffer over to the serving thread
+    void publishBackFrame();
+
+    void acceptClients();
+    void readRequest(Client &client);
+    void startStreaming(Client &client);
+
+    // Starts sending the newest frame to client if it's idle and due one
+    void serve(Client &client, std::chrono::steady_clock::time_point now);
+    // The newest frame at quality, encoding it if nobody has yet. Null if it couldn't be encoded
+    std::shared_ptr<EncodedFrame> getFrame(int quality);
+
+    // Lets go of the newest frame at any quality nobody streams at any more, so its slot can be reused
+    void dropUnwatchedFrames();
+
+    void sendPending(Client &client);
+    void watchWritable(Client &client, bool writable);
+    void disconnect(Client &client);
+
+    std::shared_ptr<EncodedFrame> getFreeSlot();
 };
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+// Morphological opening of a 0/255 mask with the 3x3 ellipse, which is a cross, in one pass over its rows
+// The same as cv::erode then cv::dilate with that element and that many iterations, borders included, without
+// the separate full-frame passes
+// Each row is packed to 64 pixels per word as it's read, and goes through a chain of erosions and then dilations
+// that each only keep the three rows they're looking at, so a pass is a few bitwise ops per 64 pixels and
+// everything in flight stays in cache. Rows are written back a few rows behind the one being read, so it works in place
+class MaskOpening
+{
+public:
+    // Erodes passes times and then dilates passes times. 0 leaves the mask as it is
+    void apply(cv::Mat &mask, int passes);
+
+private:
+    class Stage
+    {
+    public:
+        bool erode{true};
+
+        // The last three rows in, indexed by row number % 3, then a row of pixels past the edge, and the row computed
+        // from them
+        std::vector<uint64_t> rows;
+        std::vector<uint64_t> output;
+        int received{0};
+    };
+
+    // Kept between frames so steady-state frames don't allocate
+    std::vector<Stage> mStages;
+    int mStageCount{0};
+    int mWords{0};
+
+    // Which bits of the last word are past the right edge of the mask
+    uint64_t mPadding{0};
+
+    cv::Mat *mMask{nullptr};
+    int mNextOutputRow{0};
+
+    void resize(int width, int passes);
+
+    // Hands row into stage, or the row past the bottom edge if it's null, and on down the chain as far as it goes
+    void feed(int stage, const uint64_t *row);
+};
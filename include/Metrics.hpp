@@ -0,0 +1,70 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+// Counts latencies into logarithmic buckets, four per power of two microseconds, so percentiles are within 25%
+// One thread records while any number read; every counter is a relaxed atomic so neither side ever locks
+class LatencyHistogram
+{
+public:
+    static constexpr int buckets{96};
+
+    void record(std::chrono::nanoseconds latency);
+    void reset();
+
+    uint64_t getCount() const;
+    double getMeanMilliseconds() const;
+
+    // Upper edge of the bucket holding the given fraction of the samples
+    double getPercentileMilliseconds(double fraction) const;
+
+private:
+    std::array<std::atomic<uint32_t>, buckets> mBuckets{};
+    std::atomic<uint64_t> mCount{0};
+    std::atomic<uint64_t> mTotalNanoseconds{0};
+
+    static int bucketOf(uint64_t microseconds);
+    static uint64_t upperEdgeOf(int bucket);
+};
+
+// Latency of every step a frame goes through, from capture to the stream
+class Metrics
+{
+public:
+    enum Stage
+    {
+        capture,
+        segment,
+        morphology,
+        contours,
+        validation,
+        pairing,
+        send,
+        overlay,
+        // Stream JPEGs, timed on the streaming thread rather than per frame
+        encode,
+        // From the sensor capturing the frame to it being fully published
+        total,
+        stageCount
+    };
+
+    static const char *getStageName(Stage stage);
+
+    void record(Stage stage, std::chrono::nanoseconds latency);
+    void recordEncodedBytes(size_t bytes);
+    void reset();
+
+    const LatencyHistogram &getHistogram(Stage stage) const;
+
+    // Count, mean, p50 and p99 of every stage, plus the mean stream JPEG size, as YAML
+    std::string getReport() const;
+
+private:
+    std::array<LatencyHistogram, stageCount> mHistograms;
+    std::atomic<uint64_t> mEncodedFrames{0};
+    std::atomic<uint64_t> mEncodedBytes{0};
+};
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "SPSCQueue.hpp"
+#include "Thread.hpp"
+#include "VisionFrame.hpp"
+
+// Runs a chain of stages on their own threads so consecutive frames are processed concurrently
+// Frames come from a fixed pool and travel stage to stage through lock-free queues, then back to the first stage
+// A stage that sees a newer frame already waiting skips the older one, so latency stays bounded instead of queueing up
+class PipelineExecutor
+{
+public:
+    // Returning false drops the frame from every later stage
+    // The first stage produces frames and is retried on the same frame until it returns true
+    using Stage = std::function<bool(VisionFrame &)>;
+
+    PipelineExecutor(std::vector<Stage> stages);
+
+    // Runs the first stage on the calling thread and the rest on their own threads until stopFlag is set
+    void run(const std::atomic<bool> &stopFlag);
+
+    // Frames skipped because a newer one was already waiting
+    int getDroppedFrames();
+
+private:
+    class StageThread : public Thread
+    {
+    public:
+        StageThread(PipelineExecutor &executor, int stage);
+        ~StageThread();
+
+    private:
+        PipelineExecutor &mExecutor;
+        int mStage;
+
+        void run() override;
+    };
+
+    std::vector<Stage> mStages;
+    std::vector<VisionFrame> mFrames;
+
+    // mQueues[i] feeds stage i, and the last stage feeds the first
+    std::vector<std::unique_ptr<SPSCQueue<VisionFrame *>>> mQueues;
+
+    std::atomic<int> mDroppedFrames{0};
+
+    void runStage(int stage, const std::atomic<bool> &stopFlag);
+};
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// One candidate target as the robot sees it
+class RobotTarget
+{
+public:
+    float horizontalAngleError{0};
+    float area{0};
+    float width{0};
+    float confidence{0};
+};
+
+// What the robot is sent for every frame, and in between frames when predicting, in a fixed little-endian layout:
+//   uint8 version, uint8 flags, uint8 pairCount, uint8 targetCount,
+//   uint32 frameNumber, int64 captureTime, int64 processedTime,
+//   float32 filteredAngle, filteredRate, filteredConfidence,
+//   then targetCount times float32 horizontalAngleError, area, width, confidence
+// Times are microseconds on the coprocessor's steady clock, so only their difference means anything to the robot:
+// it's how long before sending the frame was captured, which the robot can look back through its gyro history for
+// The targets are as measured in the frame, while the filtered values are the smoothed estimate as of processedTime
+class RobotPacket
+{
+public:
+    static constexpr uint8_t currentVersion{2};
+    static constexpr int maxTargets{4};
+    static constexpr size_t headerSize{36};
+    static constexpr size_t targetSize{16};
+    static constexpr size_t maxSize{headerSize + maxTargets * targetSize};
+
+    enum Flags : uint8_t
+    {
+        foundTarget = 1,
+        // Only a window around the last target was searched
+        tracking = 2,
+        // Sent between frames, repeating the last frame's targets with the filtered values moved on to processedTime
+        predicted = 4
+    };
+
+    uint8_t flags{0};
+
+    // Pairs found in the frame, which may be more than fit in targets
+    int pairCount{0};
+
+    uint32_t frameNumber{0};
+    int64_t captureTime{0};
+    int64_t processedTime{0};
+
+    // Degrees and degrees per second. A confidence of 0 means there's no estimate
+    float filteredAngle{0};
+    float filteredRate{0};
+    float filteredConfidence{0};
+
+    // Best first
+    int targetCount{0};
+    std::array<RobotTarget, maxTargets> targets;
+
+    // Writes the packet into buffer, which must hold maxSize bytes, and returns how many bytes it took
+    size_t write(uint8_t *buffer) const;
+
+    // Returns false and leaves the packet alone if buffer doesn't hold a packet of this version
+    bool read(const uint8_t *buffer, size_t size);
+};
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+// Bounded lock-free queue for exactly one producer thread and one consumer thread
+// push() and pop() never lock; the mutex is only touched when the consumer sleeps in popWait()
+template <typename T>
+class SPSCQueue
+{
+private:
+    std::vector<T> mSlots;
+    alignas(64) std::atomic<size_t> mHead{0};
+    alignas(64) std::atomic<size_t> mTail{0};
+    alignas(64) std::atomic<bool> mWaiting{false};
+    std::mutex mMutex;
+    std::condition_variable mCondition;
+
+    size_t increment(size_t index) const
+    {
+        return index + 1 == mSlots.size() ? 0 : index + 1;
+    }
+
+public:
+    // One slot is always left empty to tell a full queue from an empty one
+    explicit SPSCQueue(size_t capacity) : mSlots(capacity + 1)
+    {
+    }
+
+    // Producer only. Returns false without blocking if the queue is full
+    bool push(const T &item)
+    {
+        size_t tail{mTail.load(std::memory_order_relaxed)};
+        size_t next{increment(tail)};
+        if (next == mHead.load(std::memory_order_acquire))
+            return false;
+
+        mSlots[tail] = item;
+        mTail.store(next, std::memory_order_release);
+
+        // Pairs with the fence in popWait() so either we see the consumer waiting or it sees the new item
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (mWaiting.load(std::memory_order_relaxed))
+        {
+            std::lock_guard<std::mutex> lock{mMutex};
+            mCondition.notify_one();
+        }
+
+        return true;
+    }
+
+    // Consumer only. Returns false without blocking if the queue is empty
+    bool pop(T &item)
+    {
+        size_t head{mHead.load(std::memory_order_relaxed)};
+        if (head == mTail.load(std::memory_order_acquire))
+            return false;
+
+        item = std::move(mSlots[head]);
+        mHead.store(increment(head), std::memory_order_release);
+        return true;
+    }
+
+    // Consumer only. Sleeps until an item arrives or timeout passes
+    template <typename Rep, typename Period>
+    bool popWait(T &item, std::chrono::duration<Rep, Period> timeout)
+    {
+        if (pop(item))
+            return true;
+
+        std::unique_lock<std::mutex> lock{mMutex};
+        mWaiting.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        bool popped{mCondition.wait_for(lock, timeout, [this, &item] { return pop(item); })};
+        mWaiting.store(false, std::memory_order_relaxed);
+
+        return popped;
+    }
+
+    bool empty() const
+    {
+        return mHead.load(std::memory_order_acquire) == mTail.load(std::memory_order_acquire);
+    }
+};
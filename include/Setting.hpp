@@ -33,6 +33,16 @@ public:
     }
 };
 
+class DoubleSetting : public Setting
+{
+public:
+    double value;
+
+    DoubleSetting(std::string tag) : Setting(tag)
+    {
+    }
+};
+
 class BoolSetting : public Setting
 {
 public:
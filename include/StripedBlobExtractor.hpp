@@ -0,0 +1,53 @@
+#pragma once
+
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+#include "BlobExtractor.hpp"
+#include "WorkStealingPool.hpp"
+
+// Finds the same blobs as BlobExtractor, but labels horizontal stripes of the mask in parallel and then stitches
+// together the pieces of blobs that cross from one stripe into the next
+// Only the runs on either side of each seam are compared, so stitching costs next to nothing next to labelling
+class StripedBlobExtractor
+{
+public:
+    // offset is added to every coordinate, for masks that only cover part of the frame
+    void extract(const cv::Mat &mask, cv::Point offset, int stripes, WorkStealingPool &pool);
+
+    // Statistics of the stitched blobs. firstRun and runCount aren't filled in, since a blob's runs can be spread
+    // over several stripes
+    const BlobStats &getStats() const;
+
+    // Same outline as BlobExtractor::appendOutline() would give for the blob in the whole mask
+    void appendOutline(int blob, std::vector<cv::Point> &outline);
+
+private:
+    // Kept between frames so steady-state extraction doesn't allocate
+    std::vector<BlobExtractor> mStripes;
+    int mStripeCount{0};
+
+    // A piece is one stripe's blob. Pieces are numbered stripe by stripe, starting from mFirstPiece[stripe]
+    std::vector<int> mFirstPiece;
+    std::vector<int> mPieceStripe;
+    std::vector<int> mParents;
+    std::vector<int> mBlobOfPiece;
+
+    // Pieces grouped by blob: blob b's are mPieces[mFirstPieceOfBlob[b], mFirstPieceOfBlob[b + 1])
+    std::vector<int> mPieces;
+    std::vector<int> mFirstPieceOfBlob;
+
+    // The runs either side of a seam, and each row's ends while outlining a blob made of several pieces
+    std::vector<Run> mAbove;
+    std::vector<Run> mBelow;
+    std::vector<int> mRowLeft;
+    std::vector<int> mRowRight;
+
+    BlobStats mStats;
+
+    int findRoot(int piece);
+    void unite(int a, int b);
+
+    // Joins the pieces touching across the seam above stripe
+    void stitch(int stripe, int seamY);
+};
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <chrono>
+#include <mutex>
+
+#include "Config.hpp"
+#include "VisionFrame.hpp"
+
+// Where the filter thinks the target is at some moment
+class TargetEstimate
+{
+public:
+    // False until a target is seen, and again once it's been gone longer than vision.filterDropout
+    bool valid{false};
+
+    double horizontalAngleError{0};
+
+    // Degrees per second
+    double angleRate{0};
+
+    // From 0 to 1. Follows how alike the paired strips look, and fades out over a dropout
+    double confidence{0};
+};
+
+// Smooths the chosen target's angle across frames with an alpha-beta (constant velocity) filter, and extrapolates it
+// to any moment, so the robot can be sent an estimate between frames and through short dropouts
+// Frames update it from one thread while estimates are read from another
+class TargetFilter
+{
+public:
+    // A jump bigger than this between prediction and measurement is taken to be a different target, not movement
+    static constexpr double maxJump{10};
+
+    // Folds in frame's chosen target as of when the frame was captured. Frames without one only age the estimate
+    void update(const VisionFrame &frame, const VisionConfig &config);
+
+    // The estimate moved on to time at the measured rate
+    TargetEstimate predict(std::chrono::steady_clock::time_point time) const;
+
+    void reset();
+
+private:
+    mutable std::mutex mMutex;
+
+    bool mValid{false};
+    double mAngle{0};
+    double mRate{0};
+    double mConfidence{0};
+    std::chrono::steady_clock::time_point mMeasurementTime;
+    std::chrono::milliseconds mDropout{0};
+};
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <vector>
+
+#include "Contour.hpp"
+
+// Two strips that could be one vision target, as indices into the contours they were paired from
+class ContourPair
+{
+public:
+    int left{0};
+    int right{0};
+
+    // From 0 to 1, how much the strips look like the two halves of one target: similar heights, level with each other,
+    // leaning by the same amount in opposite directions and about a target's width apart
+    double score{0};
+
+    // Halfway between the strips' centers
+    double centerX{0};
+};
+
+// Pairs up strips leaning right with a strip to their right leaning left, giving each strip to the pair most like a target
+// Sorting by x once and sweeping across only compares strips within reach of each other, so a frame of n strips costs
+// O(n log n) plus O(n·k) comparisons, where k is how many strips are within reach of any one. That's a handful in a
+// real frame, though it's n, and no better than comparing every strip with every other, when they're all bunched up
+// Nothing allocates once the buffers have grown to the largest frame seen
+class TargetPairer
+{
+public:
+    // Pairs scoring under this are too unlike a target to be one
+    static constexpr double minScore{0.2};
+
+    // Strip centers further apart than this many strip lengths can't be one target
+    static constexpr double maxSpacing{6};
+
+    // Finds every pair in contours and orders them by how close they are to the middle of a frame frameWidth wide
+    // The result is only valid until the next call
+    const std::vector<ContourPair> &pair(const std::vector<Contour> &contours, int frameWidth);
+
+private:
+    std::vector<int> mOrder;
+    std::vector<int> mOpen;
+    std::vector<ContourPair> mCandidates;
+    std::vector<bool> mPaired;
+    std::vector<ContourPair> mPairs;
+
+    static double getScore(const Contour &left, const Contour &right);
+};
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <atomic>
 #include <iostream>
 #include <thread>
 
@@ -15,8 +16,8 @@ public:
 protected:
     std::thread thread;
 
-    // function should exit if stopFlag is true
-    bool stopFlag = false;
+    // function should exit if stopFlag is true. Written by stop() while run() reads it on the thread
+    std::atomic<bool> stopFlag{false};
 
     ~Thread();
 
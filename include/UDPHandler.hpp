@@ -3,19 +3,36 @@
 #include <boost/asio.hpp>
 #include <boost/bind.hpp>
 #include <boost/array.hpp>
+#include <chrono>
 #include <string>
 #include <iostream>
 
+#include "SPSCQueue.hpp"
 #include "Thread.hpp"
 
 class UDPHandler : public Thread
 {
+public:
+    // One received message and who to answer
+    class Datagram
+    {
+    public:
+        std::string message;
+        boost::asio::ip::udp::endpoint sender;
+    };
+
 private:
     boost::asio::io_service mIoService;
     boost::asio::ip::udp::socket mSocket;
     boost::asio::ip::udp::endpoint mRemoteEndpoint;
     boost::array<char, 1024> mReceiveBuffer;
-    std::string mReceivedMessage;
+
+    // Filled by the io_service thread and emptied by whoever calls receive(), so bursts are queued rather than
+    // overwriting each other
+    // Sockets that only send leave this off, since nothing would ever empty the queue
+    bool mQueueReceived;
+    Datagram mDatagram;
+    SPSCQueue<Datagram> mReceived{64};
 
     void startReceiving();
     void handleReceive(const boost::system::error_code &error,
@@ -27,10 +44,17 @@ private:
     void stop() override;
 
 public:
-    UDPHandler(int port);
+    // With queueReceived, datagrams are kept for receive(). Otherwise they're only acknowledged
+    UDPHandler(int port, bool queueReceived = false);
     ~UDPHandler();
     void sendTo(std::string message, boost::asio::ip::udp::endpoint sendEndpoint);
+
+    // Sends straight from data without copying it, so it's safe to reuse data as soon as this returns
+    // Meant for the per-frame path, where sendTo(std::string) would allocate twice per packet
+    bool sendTo(const uint8_t *data, size_t size, const boost::asio::ip::udp::endpoint &sendEndpoint);
     void reply(std::string message);
-    std::string getMessage();
-    void clearMessage();
+
+    // Waits up to timeout for the oldest datagram not yet received. Only call from one thread, on a handler made with
+    // queueReceived
+    bool receive(Datagram &datagram, std::chrono::milliseconds timeout);
 };
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <memory>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+#include "Config.hpp"
+#include "Contour.hpp"
+#include "GstCapture.hpp"
+#include "Metrics.hpp"
+
+// A pair of strips that could be the vision target
+class Target
+{
+public:
+    double centerX{0};
+    double centerY{0};
+    double horizontalAngleError{0};
+
+    // Combined area of both strips and the width across them, in pixels, which shrink with distance
+    double area{0};
+    double width{0};
+
+    // From 0 to 1, how much the strips look like the two halves of one target
+    double confidence{0};
+};
+
+// Everything the vision pipeline works out about a single camera frame
+// Frames are pooled and reused, so the Mats keep their buffers from one capture to the next
+class VisionFrame
+{
+public:
+    int number{0};
+
+    // Set when a stage decides later stages should skip this frame
+    bool stale{false};
+
+    // Keeps the camera's buffer mapped while frame points into it
+    GstCapture::Buffer cameraBuffer;
+
+    // The settings this frame is processed with, taken when it's first segmented
+    std::shared_ptr<const VisionConfig> visionConfig;
+
+    cv::Mat frame;
+
+    // The part of frame that was searched, either a window around the last target or the whole frame
+    // mask only covers this region, while contours are in full-frame coordinates
+    cv::Rect roi;
+    cv::Mat mask;
+    cv::Mat maskBuffer;
+
+    // The parts of roi that were searched at full resolution, in full-frame coordinates: either all of it, or with a
+    // detection scale, the regions around blobs found in a downscaled copy. The rest of mask is left empty
+    std::vector<cv::Rect> regions;
+
+    // Arena for every contour's points; the contours only hold views into it
+    std::vector<cv::Point> contourPoints;
+    std::vector<Contour> contours;
+
+    // Candidate targets, best first
+    std::vector<Target> targets;
+
+    // The best target, when there is one
+    bool foundTarget{false};
+    std::array<Contour, 2> closestPair;
+    double centerX{0};
+    double centerY{0};
+    double horizontalAngleError{0};
+
+    // When the sensor captured the frame
+    std::chrono::steady_clock::time_point captureTime;
+
+    // Stages only read the clock when timed is set, and leave latencies negative for steps they skip
+    bool timed{false};
+    std::array<std::chrono::nanoseconds, Metrics::stageCount> latencies;
+};
+
+// Times a step of frame into frame.latencies from construction until it goes out of scope
+class StageTimer
+{
+public:
+    StageTimer(VisionFrame &frame, Metrics::Stage stage)
+        : mLatency{frame.timed ? &frame.latencies[stage] : nullptr}
+    {
+        if (mLatency != nullptr)
+            mStart = std::chrono::steady_clock::now();
+    }
+
+    ~StageTimer()
+    {
+        if (mLatency != nullptr)
+            *mLatency = std::chrono::steady_clock::now() - mStart;
+    }
+
+private:
+    std::chrono::nanoseconds *mLatency;
+    std::chrono::steady_clock::time_point mStart;
+};
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <array>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+#include "BlobExtractor.hpp"
+#include "CameraModel.hpp"
+#include "ColorLookupTable.hpp"
+#include "Config.hpp"
+#include "ConfigSnapshot.hpp"
+#include "MaskOpening.hpp"
+#include "StripedBlobExtractor.hpp"
+#include "TargetPairer.hpp"
+#include "VisionFrame.hpp"
+#include "WorkStealingPool.hpp"
+
+// The per-frame vision processing, split into stages that can run on separate threads
+// Each stage only touches its own members, so different frames may be in different stages at once
+class VisionPipeline
+{
+public:
+    // Each frame takes the newest published visionConfig as it starts, so new thresholds apply from the next frame
+    // The camera's settings are copied, since changing them means a new camera pipeline and a new VisionPipeline anyway
+    VisionPipeline(const ConfigSnapshot<VisionConfig> &visionConfig, const ConfigSnapshot<RaspicamConfig> &raspicamConfig);
+
+    // Picks frame.roi, then thresholds that part of frame.frame and cleans up the result into frame.mask
+    // With a detection scale, only the regions where a downscaled copy of it found blobs are thresholded
+    void segment(VisionFrame &frame);
+
+    // Finds, validates and pairs the contours in frame.mask, then picks the pair nearest the center
+    // Also moves the tracking window for the next frames to be segmented
+    void findTargets(VisionFrame &frame);
+
+    // The steps of segment() and findTargets(), in order, for timing them separately. threshold() takes the settings
+    // snapshot the others use
+    void threshold(VisionFrame &frame);
+    void removeNoise(VisionFrame &frame);
+    void findContours(VisionFrame &frame);
+    void pairContours(VisionFrame &frame);
+
+    // Runs every stage on the calling thread
+    void process(VisionFrame &frame);
+
+private:
+    const ConfigSnapshot<VisionConfig> &mVisionConfig;
+    const ConfigSnapshot<RaspicamConfig> &mRaspicamConfig;
+
+    // Workers for splitting a frame into stripes, one fewer than there are cores since the stage's own thread helps
+    // Only started the first time vision.stripes is above 1. Shared by both sides, which can run jobs on it at once
+    std::once_flag mPoolStarted;
+    std::unique_ptr<WorkStealingPool> mPool;
+
+    // Only used by segment()
+    ColorLookupTable mLookupTable;
+    MaskOpening mOpening;
+    cv::Mat mCoarseFrame;
+    cv::Mat mCoarseMask;
+    BlobExtractor mCoarseExtractor;
+    std::vector<cv::Mat> mStripeMasks;
+    std::vector<MaskOpening> mStripeOpenings;
+
+    // Only used by findTargets()
+    BlobExtractor mBlobExtractor;
+    StripedBlobExtractor mStripedExtractor;
+    std::vector<cv::Range> mOutlines;
+    TargetPairer mPairer;
+    CameraModel mCameraModel;
+    std::shared_ptr<const RaspicamConfig> mCameraConfig;
+    std::vector<std::array<cv::Point2f, 4>> mCorners;
+    std::vector<bool> mCornersRefined;
+    cv::Mat mGrayBuffer;
+    std::vector<cv::Point2f> mTargetPoints;
+    std::vector<cv::Point2f> mTargetRays;
+
+    // Once locked on, only a window around the last target is searched
+    // Written by findTargets() and read by segment(), which may be on different threads
+    std::mutex mTrackingMutex;
+    bool mTracking{false};
+    cv::Rect mTrackingWindow;
+    int mTrackingMisses{0};
+
+    // Corner windows are at most this many pixels either side, enough for strips near the camera at 640x480
+    static constexpr int maxCornerRadius{4};
+
+    // The target's angle is measured from the strips' refined corners through mCameraModel
+    Target makeTarget(const Contour &left, const Contour &right, const std::array<cv::Point2f, 4> &leftCorners,
+                      const std::array<cv::Point2f, 4> &rightCorners, double score);
+
+    // Moves contour's corners to sub-pixel positions along the edges of the strip in image
+    void refineCorners(const cv::Mat &image, const Contour &contour, std::array<cv::Point2f, 4> &corners);
+
+    cv::Rect getSearchWindow(const cv::Size &frameSize);
+
+    // Finds blobs in frame.roi downscaled by scale and sets frame.regions to the areas around them, in full-frame
+    // coordinates, for the full resolution search
+    void findCandidateRegions(VisionFrame &frame, int scale);
+
+    // Starts mPool if it hasn't been already
+    WorkStealingPool &getPool();
+
+    // Threshold and open region of frame.mask, split into vision.stripes stripes run across mPool
+    void thresholdRegion(VisionFrame &frame, const cv::Rect &region);
+    void openRegion(VisionFrame &frame, const cv::Rect &region);
+
+    void updateTracking(const VisionFrame &frame);
+};
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "Thread.hpp"
+
+// A fixed set of worker threads that split jobs of independent tasks between them, for putting every core on one frame
+// Each worker has its own queue, and one that runs out steals from the others, so uneven tasks even out without
+// every worker contending on a single queue
+// Several threads can run jobs at once, e.g. two pipeline stages on different frames, and each helps with the
+// queued tasks until its own job is done
+class WorkStealingPool
+{
+public:
+    // threads workers besides whichever threads run jobs. With none, jobs run entirely on the thread that runs them
+    WorkStealingPool(int threads);
+    ~WorkStealingPool();
+
+    // Runs task(0) to task(count - 1) and returns once they've all finished
+    // Tasks mustn't run jobs of their own
+    void run(int count, const std::function<void(int)> &task);
+
+private:
+    class Job
+    {
+    public:
+        const std::function<void(int)> *task;
+        std::atomic<int> remaining;
+    };
+
+    class Task
+    {
+    public:
+        Job *job;
+        int index;
+    };
+
+    // A fixed ring of tasks. Its worker takes the newest and thieves the oldest
+    // Tasks are coarse enough that a lock per queue is never what's slow
+    class Queue
+    {
+    public:
+        bool push(const Task &task);
+        bool popNewest(Task &task);
+        bool popOldest(Task &task);
+
+    private:
+        static constexpr int capacity{256};
+
+        std::mutex mMutex;
+        std::array<Task, capacity> mTasks;
+        int mOldest{0};
+        int mSize{0};
+    };
+
+    class Worker : public Thread
+    {
+    public:
+        Worker(WorkStealingPool &pool, int queue);
+        ~Worker();
+
+    private:
+        WorkStealingPool &mPool;
+        int mQueue;
+
+        void run() override;
+    };
+
+    std::vector<std::unique_ptr<Queue>> mQueues;
+    std::vector<std::unique_ptr<Worker>> mWorkers;
+
+    // Where the next job starts handing out tasks, so concurrent jobs don't all pile onto the first worker
+    std::atomic<int> mNextQueue{0};
+
+    // Idle workers sleep on mWake until tasks are queued, and threads running jobs on mFinished until the last of
+    // theirs finishes
+    std::mutex mMutex;
+    std::condition_variable mWake;
+    std::condition_variable mFinished;
+    std::atomic<int> mQueued{0};
+    bool mStopping{false};
+
+    // Takes a task from queue, or steals one from any other. A queue of -1 only steals
+    bool take(int queue, Task &task);
+    void execute(const Task &task);
+
+    void work(int queue);
+};
@@ -0,0 +1,25 @@
+#include "Backoff.hpp"
+
+#include <algorithm>
+#include <thread>
+
+Backoff::Backoff(std::chrono::milliseconds initialDelay, std::chrono::milliseconds maxDelay)
+    : mInitialDelay{initialDelay}, mMaxDelay{maxDelay}, mDelay{initialDelay}
+{
+}
+
+void Backoff::wait(const std::atomic<bool> &stopFlag)
+{
+    // Short slices keep stopping responsive without waking often enough to cost anything
+    const std::chrono::milliseconds slice{50};
+    std::chrono::steady_clock::time_point end{std::chrono::steady_clock::now() + mDelay};
+    while (!stopFlag && std::chrono::steady_clock::now() < end)
+        std::this_thread::sleep_for(std::min<std::chrono::steady_clock::duration>(slice, end - std::chrono::steady_clock::now()));
+
+    mDelay = std::min(mDelay * 2, mMaxDelay);
+}
+
+void Backoff::reset()
+{
+    mDelay = mInitialDelay;
+}
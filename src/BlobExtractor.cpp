@@ -0,0 +1,181 @@
+#include "BlobExtractor.hpp"
+
+#include <climits>
+#include <cstdint>
+#include <cstring>
+
+namespace
+{
+// Sum of x^2 for x in [0, k]
+inline double sumOfSquares(double k)
+{
+    return k * (k + 1) * (2 * k + 1) / 6;
+}
+
+inline bool isEmptyWord(const uchar *pixels)
+{
+    uint64_t word;
+    std::memcpy(&word, pixels, sizeof(word));
+    return word == 0;
+}
+} // namespace
+
+void BlobStats::resize(int blobs)
+{
+    area.assign(blobs, 0);
+    left.assign(blobs, INT_MAX);
+    top.assign(blobs, INT_MAX);
+    right.assign(blobs, INT_MIN);
+    bottom.assign(blobs, INT_MIN);
+    m10.assign(blobs, 0);
+    m01.assign(blobs, 0);
+    m20.assign(blobs, 0);
+    m11.assign(blobs, 0);
+    m02.assign(blobs, 0);
+    firstRun.assign(blobs, 0);
+    runCount.assign(blobs, 0);
+}
+
+void BlobExtractor::extract(const cv::Mat &mask, cv::Point offset)
+{
+    CV_Assert(mask.type() == CV_8UC1);
+
+    mScanRuns.clear();
+    mParents.clear();
+
+    // Splits each row into runs and merges them with the runs they touch on the row above
+    int previousRowBegin{0}, previousRowEnd{0};
+    for (int y{0}; y < mask.rows; ++y)
+    {
+        const uchar *row{mask.ptr<uchar>(y)};
+        int rowBegin{static_cast<int>(mScanRuns.size())};
+        int above{previousRowBegin};
+
+        for (int x{0}; x < mask.cols;)
+        {
+            // Masks are mostly empty, so skip eight pixels at a time where we can
+            while (x + 8 <= mask.cols && isEmptyWord(row + x))
+                x += 8;
+            while (x < mask.cols && row[x] == 0)
+                ++x;
+            if (x == mask.cols)
+                break;
+
+            int start{x};
+            while (x < mask.cols && row[x] != 0)
+                ++x;
+            int end{x - 1};
+
+            int run{static_cast<int>(mScanRuns.size())};
+            mScanRuns.push_back(Run{y, start, end, 0});
+            mParents.push_back(run);
+
+            // Runs above that end left of this one can't touch any later run on this row either
+            // Diagonal neighbours count as touching, hence the 1 pixel of slack
+            while (above < previousRowEnd && mScanRuns[above].end < start - 1)
+                ++above;
+            for (int candidate{above}; candidate < previousRowEnd && mScanRuns[candidate].start <= end + 1; ++candidate)
+                unite(run, candidate);
+        }
+
+        previousRowBegin = rowBegin;
+        previousRowEnd = mScanRuns.size();
+    }
+
+    // Numbers the blobs in order of their first run
+    int runs{static_cast<int>(mScanRuns.size())};
+    int blobs{0};
+    mBlobOfRoot.assign(runs, -1);
+    for (int run{0}; run < runs; ++run)
+    {
+        int root{findRoot(run)};
+        if (mBlobOfRoot[root] == -1)
+            mBlobOfRoot[root] = blobs++;
+        mScanRuns[run].blob = mBlobOfRoot[root];
+    }
+
+    mStats.resize(blobs);
+    for (const Run &run : mScanRuns)
+        ++mStats.runCount[run.blob];
+    for (int blob{1}; blob < blobs; ++blob)
+        mStats.firstRun[blob] = mStats.firstRun[blob - 1] + mStats.runCount[blob - 1];
+
+    // Groups the runs by blob, which keeps them in row order, while gathering the statistics
+    // mBlobOfRoot is done with, so it doubles as each blob's next free slot
+    std::vector<int> &nextSlot{mBlobOfRoot};
+    for (int blob{0}; blob < blobs; ++blob)
+        nextSlot[blob] = mStats.firstRun[blob];
+
+    mRuns.resize(runs);
+    for (const Run &scanRun : mScanRuns)
+    {
+        Run run{scanRun.y + offset.y, scanRun.start + offset.x, scanRun.end + offset.x, scanRun.blob};
+        mRuns[nextSlot[run.blob]++] = run;
+
+        int blob{run.blob};
+        int length{run.end - run.start + 1};
+        double sumX{(run.start + run.end) * 0.5 * length};
+        double sumXSquared{sumOfSquares(run.end) - sumOfSquares(run.start - 1)};
+
+        mStats.area[blob] += length;
+        mStats.left[blob] = std::min(mStats.left[blob], run.start);
+        mStats.right[blob] = std::max(mStats.right[blob], run.end);
+        mStats.top[blob] = std::min(mStats.top[blob], run.y);
+        mStats.bottom[blob] = std::max(mStats.bottom[blob], run.y);
+        mStats.m10[blob] += sumX;
+        mStats.m01[blob] += static_cast<double>(run.y) * length;
+        mStats.m20[blob] += sumXSquared;
+        mStats.m11[blob] += run.y * sumX;
+        mStats.m02[blob] += static_cast<double>(run.y) * run.y * length;
+    }
+}
+
+const BlobStats &BlobExtractor::getStats() const
+{
+    return mStats;
+}
+
+const std::vector<Run> &BlobExtractor::getRuns() const
+{
+    return mRuns;
+}
+
+void BlobExtractor::appendOutline(int blob, std::vector<cv::Point> &outline) const
+{
+    int first{mStats.firstRun.at(blob)};
+    int last{first + mStats.runCount.at(blob) - 1};
+
+    // Runs within a row are in x order, so the first run of a row starts furthest left and the last ends furthest right
+    for (int run{first}; run <= last; ++run)
+    {
+        if (run == first || mRuns[run].y != mRuns[run - 1].y)
+            outline.push_back(cv::Point{mRuns[run].start, mRuns[run].y});
+    }
+    for (int run{last}; run >= first; --run)
+    {
+        if (run == last || mRuns[run].y != mRuns[run + 1].y)
+            outline.push_back(cv::Point{mRuns[run].end, mRuns[run].y});
+    }
+}
+
+int BlobExtractor::findRoot(int run)
+{
+    // Path halving keeps the trees flat without recursion
+    while (mParents[run] != run)
+    {
+        mParents[run] = mParents[mParents[run]];
+        run = mParents[run];
+    }
+    return run;
+}
+
+void BlobExtractor::unite(int a, int b)
+{
+    int rootA{findRoot(a)}, rootB{findRoot(b)};
+
+    // The earlier run stays the root
+    if (rootA < rootB)
+        mParents[rootB] = rootA;
+    else if (rootB < rootA)
+        mParents[rootA] = rootB;
+}
@@ -0,0 +1,59 @@
+#include "CameraModel.hpp"
+
+#include <cmath>
+
+void CameraModel::setConfig(const RaspicamConfig &config)
+{
+    mConfig = config;
+    mDistortion = cv::Matx<double, 1, 5>{config.distortionK1.value, config.distortionK2.value, config.distortionP1.value,
+                                         config.distortionP2.value, config.distortionK3.value};
+    mDistorted = mDistortion != cv::Matx<double, 1, 5>::zeros();
+
+    // The intrinsics are worked out again for whatever size frames come next
+    mFrameSize = cv::Size{};
+}
+
+void CameraModel::setFrameSize(cv::Size size)
+{
+    if (size == mFrameSize || size.area() <= 0)
+        return;
+    mFrameSize = size;
+
+    double calibratedWidth{mConfig.width.value > 0 ? static_cast<double>(mConfig.width.value) : size.width};
+    double calibratedHeight{mConfig.height.value > 0 ? static_cast<double>(mConfig.height.value) : size.height};
+
+    // A pinhole camera with the configured field of view, unless it's been calibrated
+    double fovFocalLength{(calibratedWidth / 2) / std::tan(mConfig.horizontalFov.value * CV_PI / 360)};
+    double focalLengthX{mConfig.focalLengthX.value > 0 ? mConfig.focalLengthX.value : fovFocalLength};
+    double focalLengthY{mConfig.focalLengthY.value > 0 ? mConfig.focalLengthY.value : focalLengthX};
+    double principalPointX{mConfig.principalPointX.value > 0 ? mConfig.principalPointX.value : (calibratedWidth - 1) / 2};
+    double principalPointY{mConfig.principalPointY.value > 0 ? mConfig.principalPointY.value : (calibratedHeight - 1) / 2};
+
+    // Pixel centres scale about the corner of the first pixel, which is half a pixel before its centre
+    double scaleX{size.width / calibratedWidth}, scaleY{size.height / calibratedHeight};
+    mCameraMatrix = cv::Matx33d{focalLengthX * scaleX, 0, (principalPointX + 0.5) * scaleX - 0.5,
+                                0, focalLengthY * scaleY, (principalPointY + 0.5) * scaleY - 0.5,
+                                0, 0, 1};
+}
+
+void CameraModel::toRays(const std::vector<cv::Point2f> &points, std::vector<cv::Point2f> &rays) const
+{
+    if (mDistorted)
+    {
+        cv::undistortPoints(points, rays, mCameraMatrix, mDistortion);
+        return;
+    }
+
+    // Without distortion it's only the intrinsics to undo
+    rays.resize(points.size());
+    for (size_t p{0}; p < points.size(); ++p)
+    {
+        rays[p] = cv::Point2f{static_cast<float>((points[p].x - mCameraMatrix(0, 2)) / mCameraMatrix(0, 0)),
+                              static_cast<float>((points[p].y - mCameraMatrix(1, 2)) / mCameraMatrix(1, 1))};
+    }
+}
+
+double CameraModel::getHorizontalAngle(const cv::Point2f &ray)
+{
+    return std::atan(ray.x) * 180 / CV_PI;
+}
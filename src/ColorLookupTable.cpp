@@ -0,0 +1,86 @@
+#include "ColorLookupTable.hpp"
+
+namespace
+{
+constexpr int cellShift{8 - ColorLookupTable::bitsPerChannel};
+
+inline int cellIndex(int blue, int green, int red)
+{
+    return (blue >> cellShift) << (2 * ColorLookupTable::bitsPerChannel) |
+           (green >> cellShift) << ColorLookupTable::bitsPerChannel |
+           red >> cellShift;
+}
+} // namespace
+
+ColorLookupTable::ColorLookupTable()
+{
+}
+
+bool ColorLookupTable::update(const HSVThreshold &threshold)
+{
+    if (mBuilt &&
+        threshold.lowHue == mThreshold.lowHue && threshold.highHue == mThreshold.highHue &&
+        threshold.lowSaturation == mThreshold.lowSaturation && threshold.highSaturation == mThreshold.highSaturation &&
+        threshold.lowValue == mThreshold.lowValue && threshold.highValue == mThreshold.highValue)
+        return false;
+
+    rebuild(threshold);
+    return true;
+}
+
+void ColorLookupTable::rebuild(const HSVThreshold &threshold)
+{
+    // Lays the center color of every cell out as an image so the vectorized threshold classifies them all in one call
+    const int halfCell{1 << cellShift >> 1};
+    cv::Mat cellColors{cellsPerChannel * cellsPerChannel, cellsPerChannel, CV_8UC3};
+    for (int blue{0}; blue < cellsPerChannel; ++blue)
+    {
+        for (int green{0}; green < cellsPerChannel; ++green)
+        {
+            uchar *row{cellColors.ptr<uchar>(blue * cellsPerChannel + green)};
+            for (int red{0}; red < cellsPerChannel; ++red)
+            {
+                row[red * 3] = (blue << cellShift) + halfCell;
+                row[red * 3 + 1] = (green << cellShift) + halfCell;
+                row[red * 3 + 2] = (red << cellShift) + halfCell;
+            }
+        }
+    }
+
+    cv::Mat cellMask;
+    threshold.apply(cellColors, cellMask);
+
+    // Rows of cellMask follow the same blue-major, green, red order as cellIndex
+    mTable.fill(0);
+    for (int cell{0}; cell < cells; ++cell)
+    {
+        if (cellMask.data[cell])
+            mTable[cell >> 3] |= 1 << (cell & 7);
+    }
+
+    mThreshold = threshold;
+    mBuilt = true;
+}
+
+void ColorLookupTable::apply(const cv::Mat &bgrFrame, cv::Mat &mask) const
+{
+    CV_Assert(bgrFrame.type() == CV_8UC3);
+    CV_Assert(mask.data != bgrFrame.data);
+
+    mask.create(bgrFrame.rows, bgrFrame.cols, CV_8UC1);
+
+    const uint8_t *table{mTable.data()};
+    for (int y{0}; y < bgrFrame.rows; ++y)
+    {
+        const uchar *bgrRow{bgrFrame.ptr<uchar>(y)};
+        uchar *maskRow{mask.ptr<uchar>(y)};
+
+        for (int x{0}; x < bgrFrame.cols; ++x, bgrRow += 3)
+        {
+            int cell{cellIndex(bgrRow[0], bgrRow[1], bgrRow[2])};
+
+            // Branchless: negating the cell's bit gives either 0 or all ones
+            maskRow[x] = static_cast<uchar>(-((table[cell >> 3] >> (cell & 7)) & 1));
+        }
+    }
+}
@@ -0,0 +1,122 @@
+#include "Config.hpp"
+
+#include <iostream>
+
+namespace
+{
+// Settings missing from yaml keep currentValue, so configs from an older VisionCommunicator don't zero newer settings
+template <typename T>
+T getYamlValue(YAML::Node yaml, std::string category, std::string setting, T currentValue)
+{
+    if (yaml[setting])
+        return yaml[setting].as<T>();
+
+    if (!yaml[category] || !yaml[category][setting])
+    {
+        std::cout << "Could not find setting " << setting << " in category " << category << '\n';
+        return currentValue;
+    }
+
+    return yaml[category][setting].as<T>();
+}
+} // namespace
+
+void Config::parse(YAML::Node yaml)
+{
+    for (Setting *setting : settings)
+    {
+        if (dynamic_cast<IntSetting *>(setting) != nullptr)
+        {
+            dynamic_cast<IntSetting *>(setting)->value = getYamlValue<int>(yaml, mTag, setting->getTag(), dynamic_cast<IntSetting *>(setting)->value);
+        }
+        else if (dynamic_cast<DoubleSetting *>(setting) != nullptr)
+        {
+            dynamic_cast<DoubleSetting *>(setting)->value = getYamlValue<double>(yaml, mTag, setting->getTag(), dynamic_cast<DoubleSetting *>(setting)->value);
+        }
+        else if (dynamic_cast<BoolSetting *>(setting) != nullptr)
+        {
+            dynamic_cast<BoolSetting *>(setting)->value = getYamlValue<bool>(yaml, mTag, setting->getTag(), dynamic_cast<BoolSetting *>(setting)->value);
+        }
+        else if (dynamic_cast<StringSetting *>(setting) != nullptr)
+        {
+            std::string value = getYamlValue<std::string>(yaml, mTag, setting->getTag(), std::string{});
+            if (value != std::string{})
+                dynamic_cast<StringSetting *>(setting)->value = value;
+        }
+    }
+}
+
+void Config::emit(YAML::Node &yaml)
+{
+    for (Setting *setting : settings)
+    {
+        if (dynamic_cast<IntSetting *>(setting) != nullptr)
+        {
+            yaml[mTag][setting->getTag()] = dynamic_cast<IntSetting *>(setting)->value;
+        }
+        else if (dynamic_cast<DoubleSetting *>(setting) != nullptr)
+        {
+            yaml[mTag][setting->getTag()] = dynamic_cast<DoubleSetting *>(setting)->value;
+        }
+        else if (dynamic_cast<BoolSetting *>(setting) != nullptr)
+        {
+            yaml[mTag][setting->getTag()] = dynamic_cast<BoolSetting *>(setting)->value;
+        }
+        else if (dynamic_cast<StringSetting *>(setting) != nullptr)
+        {
+            yaml[mTag][setting->getTag()] = dynamic_cast<StringSetting *>(setting)->value;
+        }
+    }
+}
+
+void Config::copyValues(const Config &other)
+{
+    for (size_t s{0}; s < settings.size(); ++s)
+    {
+        if (dynamic_cast<IntSetting *>(settings.at(s)) != nullptr)
+        {
+            dynamic_cast<IntSetting *>(settings.at(s))->value = dynamic_cast<IntSetting *>(other.settings.at(s))->value;
+        }
+        else if (dynamic_cast<DoubleSetting *>(settings.at(s)) != nullptr)
+        {
+            dynamic_cast<DoubleSetting *>(settings.at(s))->value = dynamic_cast<DoubleSetting *>(other.settings.at(s))->value;
+        }
+        else if (dynamic_cast<BoolSetting *>(settings.at(s)) != nullptr)
+        {
+            dynamic_cast<BoolSetting *>(settings.at(s))->value = dynamic_cast<BoolSetting *>(other.settings.at(s))->value;
+        }
+        else if (dynamic_cast<StringSetting *>(settings.at(s)) != nullptr)
+        {
+            dynamic_cast<StringSetting *>(settings.at(s))->value = dynamic_cast<StringSetting *>(other.settings.at(s))->value;
+        }
+    }
+}
+
+bool Config::hasSameValues(const Config &other) const
+{
+    for (size_t s{0}; s < settings.size(); ++s)
+    {
+        if (dynamic_cast<IntSetting *>(settings.at(s)) != nullptr)
+        {
+            if (dynamic_cast<IntSetting *>(settings.at(s))->value != dynamic_cast<IntSetting *>(other.settings.at(s))->value)
+                return false;
+        }
+        else if (dynamic_cast<DoubleSetting *>(settings.at(s)) != nullptr)
+        {
+            if (dynamic_cast<DoubleSetting *>(settings.at(s))->value != dynamic_cast<DoubleSetting *>(other.settings.at(s))->value)
+                return false;
+        }
+        else if (dynamic_cast<BoolSetting *>(settings.at(s)) != nullptr)
+        {
+            if (dynamic_cast<BoolSetting *>(settings.at(s))->value != dynamic_cast<BoolSetting *>(other.settings.at(s))->value)
+                return false;
+        }
+        else if (dynamic_cast<StringSetting *>(settings.at(s)) != nullptr)
+        {
+            if (dynamic_cast<StringSetting *>(settings.at(s))->value != dynamic_cast<StringSetting *>(other.settings.at(s))->value)
+                return false;
+        }
+    }
+
+    return true;
+}
@@ -1,3 +1,6 @@
+#include <algorithm>
+#include <climits>
+#include <cmath>
 #include <iostream>
 #include "Contour.hpp"
 
@@ -5,62 +8,78 @@ Contour::Contour()
 {
 }
 
-Contour::Contour(std::vector<cv::Point> &pointsVector)
-    : pointsVector{pointsVector}
+Contour::Contour(const cv::Point *points, int pointCount)
+    : points{points}, pointCount{pointCount}
 {
 }
 
 bool Contour::isValid(double minArea, double maxArea, double minRotation, int error)
 {
-    // Approximates a closed polygon with error 3 around the contour and assigns it to newPoly
-    cv::Mat newPoly;
+    // Measures the outline in a single pass: its bounding box, and its area and moments by summing over its edges
+    // Coordinates are taken relative to the first point to keep the sums small
+    // From https://en.wikipedia.org/wiki/Second_moment_of_area#Any_polygon
+    int left{INT_MAX}, top{INT_MAX}, right{INT_MIN}, bottom{INT_MIN};
+    double a{0}, m10{0}, m01{0}, m20{0}, m11{0}, m02{0};
+    for (int p{0}; p < pointCount; ++p)
+    {
+        const cv::Point &point{points[p]};
+        left = std::min(left, point.x);
+        top = std::min(top, point.y);
+        right = std::max(right, point.x);
+        bottom = std::max(bottom, point.y);
 
-    cv::approxPolyDP(cv::Mat(pointsVector), newPoly, error, true);
+        const cv::Point &next{points[p + 1 < pointCount ? p + 1 : 0]};
+        double x0{static_cast<double>(point.x - points[0].x)}, y0{static_cast<double>(point.y - points[0].y)};
+        double x1{static_cast<double>(next.x - points[0].x)}, y1{static_cast<double>(next.y - points[0].y)};
+        double cross{x0 * y1 - x1 * y0};
 
-    // Saves the dimensions of the contour
-    area = cv::contourArea(pointsVector);
-    rotatedBoundingBox = cv::minAreaRect(newPoly);
+        a += cross;
+        m10 += (x0 + x1) * cross;
+        m01 += (y0 + y1) * cross;
+        m20 += (x0 * x0 + x0 * x1 + x1 * x1) * cross;
+        m11 += (x0 * y1 + 2 * x0 * y0 + 2 * x1 * y1 + x1 * y0) * cross;
+        m02 += (y0 * y0 + y0 * y1 + y1 * y1) * cross;
+    }
+
+    // Twice the signed area. Which way round the outline goes only changes the sign, which dividing by it cancels
+    area = std::abs(a) / 2;
 
-    // If the area of the contour is less than the specified minimum area, delete it
-    if (area < minArea || area > maxArea)
+    // If the area of the contour is outside the specified bounds, delete it
+    if (area < minArea || area > maxArea || area == 0)
         return false;
 
-    // Draws a rotated rectangle around the contour and assigns its points to points[]
-    rotatedBoundingBox.points(rotatedBoundingBoxPoints);
+    // Saves a bounding box for the contour
+    boundingBox = cv::Rect{left, top, right - left + 1, bottom - top + 1};
 
-    // Finds the indices of the highest and second-lowest points of the rotated rectangle
-    int highestPoint{0}, secondLowestPoint{0};
-    for (int i{0}; i < 4; ++i)
-    {
-        int pointsHigherThan{0}, pointsLowerThan{0};
+    // A strip leaning at least minRotation from flat is at least tan(minRotation) times as tall as it is wide, and
+    // more the thicker it is, so a box any flatter can't hold one
+    // Past 45 degrees squares pass this, so it's left to the angle check below
+    if (minRotation < 45 && boundingBox.height < boundingBox.width * std::tan(minRotation * CV_PI / 180))
+        return false;
 
-        for (int o{0}; o < 4; ++o)
-        {
-            if (rotatedBoundingBoxPoints[i].y < rotatedBoundingBoxPoints[o].y)
-                ++pointsHigherThan;
-            if (rotatedBoundingBoxPoints[i].y > rotatedBoundingBoxPoints[o].y)
-                ++pointsLowerThan;
-        }
+    // The angle of the long axis from the central moments, which unlike a rotated rectangle's corners doesn't depend
+    // on which edge counts as the top
+    double centerX{m10 / (3 * a)}, centerY{m01 / (3 * a)};
+    double mu20{m20 / (6 * a) - centerX * centerX};
+    double mu11{m11 / (12 * a) - centerX * centerY};
+    double mu02{m02 / (6 * a) - centerY * centerY};
 
-        if (pointsHigherThan == 3)
-            highestPoint = i;
-        else if (pointsLowerThan == 2)
-            secondLowestPoint = i;
-    }
-
-    // Uses the highest and second-lowest points to calculate the rectangle's rotation
-    // OpenCV provides a function for this, but it's not consistent with what edge is counted as the top and which indices count for which corners
-    angle = std::atan((rotatedBoundingBoxPoints[secondLowestPoint].y - rotatedBoundingBoxPoints[highestPoint].y) / (rotatedBoundingBoxPoints[highestPoint].x - rotatedBoundingBoxPoints[secondLowestPoint].x)) * 180 / 3.1415926;
+    // Positive when the strip leans right, with y pointing down the image
+    angle = -0.5 * std::atan2(2 * mu11, mu20 - mu02) * 180 / CV_PI;
 
     // If the angle isn't steep enough, delete the contour
-    if ((angle < 0 && angle > -minRotation) || (angle > 0 && angle < minRotation))
-    {
-	    //std::cout << "Bad angle: " << angle << "\n\n";
+    if (std::abs(angle) < minRotation)
         return false;
-    }
 
-    // Saves a bounding box for the contour
-    boundingBox = cv::boundingRect(newPoly);
+    // Only contours that passed everything else are worth fitting a rectangle to
+    // Approximates a closed polygon with error 3 around the contour and assigns it to newPoly
+    // Reused between calls on the same thread so it stops allocating once it's big enough
+    static thread_local std::vector<cv::Point> newPoly;
+
+    // Wraps the points without copying them
+    cv::approxPolyDP(cv::Mat{pointCount, 1, CV_32SC2, const_cast<cv::Point *>(points)}, newPoly, error, true);
+    rotatedBoundingBox = cv::minAreaRect(newPoly);
+    rotatedBoundingBox.points(rotatedBoundingBoxPoints);
 
     return true;
-}
\ No newline at end of file
+}
@@ -0,0 +1,219 @@
+#include "GstCapture.hpp"
+
+#include <iostream>
+#include <gst/video/video.h>
+
+GstCapture::Buffer::Buffer()
+{
+}
+
+GstCapture::Buffer::~Buffer()
+{
+    release();
+}
+
+void GstCapture::Buffer::release()
+{
+    frame.release();
+
+    if (mSample != nullptr)
+    {
+        gst_buffer_unmap(mBuffer, &mMap);
+        gst_sample_unref(mSample);
+        mSample = nullptr;
+        mBuffer = nullptr;
+    }
+}
+
+GstCapture::GstCapture(std::string source, Format format) : mSource{source}, mFormat{format}
+{
+    gst_init(nullptr, nullptr);
+}
+
+GstCapture::~GstCapture()
+{
+    release();
+}
+
+bool GstCapture::open()
+{
+    release();
+
+    // videoconvert passes buffers already in the format straight through, so it only costs anything if the source
+    // can't produce it itself. JPEG frames can't be converted to, so the source has to produce those
+    // The appsink keeps just the newest sample and drops the rest
+    std::string description{mSource};
+    if (mFormat == bgr)
+        description += " ! videoconvert ! video/x-raw,format=BGR";
+    else if (mFormat == i420)
+        description += " ! videoconvert ! video/x-raw,format=I420";
+    else
+        description += " ! image/jpeg";
+    description += " ! appsink name=sink max-buffers=1 drop=true sync=false";
+
+    GError *error{nullptr};
+    mPipeline = gst_parse_launch(description.c_str(), &error);
+    if (error != nullptr)
+    {
+        std::cout << "Could not create capture pipeline: " << error->message << '\n';
+        g_clear_error(&error);
+
+        if (mPipeline != nullptr)
+        {
+            gst_object_unref(mPipeline);
+            mPipeline = nullptr;
+        }
+        return false;
+    }
+
+    mSink = gst_bin_get_by_name(GST_BIN(mPipeline), "sink");
+
+    if (gst_element_set_state(mPipeline, GST_STATE_PLAYING) == GST_STATE_CHANGE_FAILURE)
+    {
+        std::cout << "Could not start capture pipeline: " << description << '\n';
+        release();
+        return false;
+    }
+
+    return true;
+}
+
+bool GstCapture::isOpened()
+{
+    return mPipeline != nullptr;
+}
+
+GstCapture::Format GstCapture::getFormat()
+{
+    return mFormat;
+}
+
+void GstCapture::release()
+{
+    if (mPipeline == nullptr)
+        return;
+
+    gst_element_set_state(mPipeline, GST_STATE_NULL);
+    gst_object_unref(mSink);
+    gst_object_unref(mPipeline);
+    mSink = nullptr;
+    mPipeline = nullptr;
+}
+
+bool GstCapture::read(Buffer &buffer, std::chrono::milliseconds timeout)
+{
+    if (!isOpened())
+        return false;
+
+    GstSample *sample{gst_app_sink_try_pull_sample(GST_APP_SINK(mSink), timeout.count() * GST_MSECOND)};
+    if (sample == nullptr)
+        return false;
+
+    GstBuffer *gstBuffer{gst_sample_get_buffer(sample)};
+    GstMapInfo map;
+    if (!gst_buffer_map(gstBuffer, &map, GST_MAP_READ))
+    {
+        gst_sample_unref(sample);
+        return false;
+    }
+
+    cv::Mat frame{wrapFrame(sample, map)};
+    if (frame.empty())
+    {
+        gst_buffer_unmap(gstBuffer, &map);
+        gst_sample_unref(sample);
+        return false;
+    }
+
+    // Only let go of the previous frame once the new one is mapped
+    buffer.release();
+    buffer.mSample = sample;
+    buffer.mBuffer = gstBuffer;
+    buffer.mMap = map;
+    buffer.frame = frame;
+    buffer.captureTime = getCaptureTime(gstBuffer);
+
+    return true;
+}
+
+bool GstCapture::isEndOfStream()
+{
+    return isOpened() && gst_app_sink_is_eos(GST_APP_SINK(mSink));
+}
+
+bool GstCapture::hasStopped()
+{
+    if (!isOpened() || isEndOfStream())
+        return true;
+
+    GstBus *bus{gst_element_get_bus(mPipeline)};
+    GstMessage *message{gst_bus_pop_filtered(bus, GST_MESSAGE_ERROR)};
+    gst_object_unref(bus);
+
+    if (message == nullptr)
+        return false;
+
+    GError *error{nullptr};
+    gchar *debug{nullptr};
+    gst_message_parse_error(message, &error, &debug);
+    std::cout << "Capture pipeline failed: " << (error != nullptr ? error->message : "unknown error") << '\n';
+    g_clear_error(&error);
+    g_free(debug);
+    gst_message_unref(message);
+
+    return true;
+}
+
+cv::Mat GstCapture::wrapFrame(GstSample *sample, const GstMapInfo &map)
+{
+    if (mFormat == jpeg)
+        return cv::Mat{1, static_cast<int>(map.size), CV_8UC1, map.data};
+
+    GstVideoInfo info;
+    if (!gst_video_info_from_caps(&info, gst_sample_get_caps(sample)))
+        return cv::Mat{};
+
+    int width{GST_VIDEO_INFO_WIDTH(&info)};
+    int height{GST_VIDEO_INFO_HEIGHT(&info)};
+
+    // GStreamer pads BGR rows to four bytes, so the stride comes from the caps rather than the width
+    if (mFormat == bgr)
+        return cv::Mat{height, width, CV_8UC3, map.data + GST_VIDEO_INFO_PLANE_OFFSET(&info, 0), static_cast<size_t>(GST_VIDEO_INFO_PLANE_STRIDE(&info, 0))};
+
+    // The planes only make one Mat when nothing pads them, which holds for widths that are a multiple of eight
+    bool packed{GST_VIDEO_INFO_PLANE_STRIDE(&info, 0) == width && GST_VIDEO_INFO_PLANE_STRIDE(&info, 1) == width / 2 &&
+                GST_VIDEO_INFO_PLANE_STRIDE(&info, 2) == width / 2 && GST_VIDEO_INFO_PLANE_OFFSET(&info, 0) == 0 &&
+                GST_VIDEO_INFO_PLANE_OFFSET(&info, 1) == static_cast<size_t>(width * height) &&
+                GST_VIDEO_INFO_PLANE_OFFSET(&info, 2) == static_cast<size_t>(width * height * 5 / 4)};
+    if (!packed)
+    {
+        std::cout << "Could not capture " << width << 'x' << height << " I420 frames with padded planes\n";
+        return cv::Mat{};
+    }
+
+    return cv::Mat{height * 3 / 2, width, CV_8UC1, map.data};
+}
+
+std::chrono::steady_clock::time_point GstCapture::getCaptureTime(GstBuffer *gstBuffer)
+{
+    std::chrono::steady_clock::time_point now{std::chrono::steady_clock::now()};
+
+    GstClock *clock{gst_element_get_clock(mPipeline)};
+    if (clock == nullptr || !GST_BUFFER_PTS_IS_VALID(gstBuffer))
+    {
+        if (clock != nullptr)
+            gst_object_unref(clock);
+        return now;
+    }
+
+    // The PTS is running time, so adding the base time puts it on the pipeline clock
+    // How long ago that was on the pipeline clock is how long ago it was on ours, whatever clock the pipeline uses
+    GstClockTime clockTime{gst_clock_get_time(clock)};
+    GstClockTime sensorTime{gst_element_get_base_time(mPipeline) + GST_BUFFER_PTS(gstBuffer)};
+    gst_object_unref(clock);
+
+    if (sensorTime > clockTime)
+        return now;
+
+    return now - std::chrono::nanoseconds{clockTime - sensorTime};
+}
@@ -0,0 +1,150 @@
+#include "HSVThreshold.hpp"
+
+#include <opencv2/core/hal/intrin.hpp>
+
+// OpenCV's 8-bit HSV uses S = 255 * diff / V and H = 30 * sector / diff, each rounded to the nearest integer
+// Rounding is folded into the thresholds (x rounds into [low, high] iff low - 0.5 <= x < high + 0.5) and both
+// sides are multiplied through by the divisor, so the per-pixel test needs no division or lookup table
+// The result matches cvtColor + inRange except for OpenCV's own fixed-point error right on a threshold
+
+namespace
+{
+#if CV_SIMD128
+// Thresholds broadcast into vector lanes once per row
+struct ThresholdLanes
+{
+    cv::v_float32x4 lowHue, highHue, lowSaturation, highSaturation, lowValue, highValue;
+    cv::v_float32x4 zero, two, four, six, sixty, fiveHundredTen;
+    cv::v_uint32x4 achromatic, maskValue;
+};
+
+inline cv::v_float32x4 toFloat(const cv::v_uint32x4 &lanes)
+{
+    return cv::v_cvt_f32(cv::v_reinterpret_as_s32(lanes));
+}
+
+// Tests four pixels at once, returning 255 in each lane that is within the thresholds
+// Every intermediate value is an integer below 2^24, so single-precision floats are exact
+inline cv::v_uint32x4 thresholdLanes(const cv::v_uint32x4 &blueLanes, const cv::v_uint32x4 &greenLanes,
+                                     const cv::v_uint32x4 &redLanes, const ThresholdLanes &t)
+{
+    cv::v_float32x4 blue{toFloat(blueLanes)}, green{toFloat(greenLanes)}, red{toFloat(redLanes)};
+    cv::v_float32x4 value{cv::v_max(blue, cv::v_max(green, red))};
+    cv::v_float32x4 diff{value - cv::v_min(blue, cv::v_min(green, red))};
+
+    cv::v_float32x4 valueInRange{(value >= t.lowValue) & (value <= t.highValue)};
+
+    cv::v_float32x4 saturation{diff * t.fiveHundredTen};
+    cv::v_float32x4 saturationInRange{(saturation >= t.lowSaturation * value) & (saturation < t.highSaturation * value)};
+
+    cv::v_float32x4 redHue{green - blue + cv::v_select((blue - green) * t.sixty > diff, diff * t.six, t.zero)};
+    cv::v_float32x4 greenHue{blue - red + diff * t.two};
+    cv::v_float32x4 blueHue{red - green + diff * t.four};
+    cv::v_float32x4 hue{cv::v_select(value == red, redHue, cv::v_select(value == green, greenHue, blueHue)) * t.sixty};
+    cv::v_float32x4 hueInRange{(hue >= t.lowHue * diff) & (hue < t.highHue * diff)};
+
+    // Greys have no hue or saturation, which OpenCV reports as 0
+    cv::v_uint32x4 chromatic{cv::v_reinterpret_as_u32(saturationInRange & hueInRange)};
+    cv::v_uint32x4 inRange{cv::v_reinterpret_as_u32(valueInRange) &
+                           cv::v_select(cv::v_reinterpret_as_u32(diff == t.zero), t.achromatic, chromatic)};
+
+    return inRange & t.maskValue;
+}
+#endif
+} // namespace
+
+HSVThreshold::HSVThreshold()
+{
+}
+
+HSVThreshold::HSVThreshold(int lowHue, int lowSaturation, int lowValue, int highHue, int highSaturation, int highValue)
+    : lowHue{lowHue}, lowSaturation{lowSaturation}, lowValue{lowValue},
+      highHue{highHue}, highSaturation{highSaturation}, highValue{highValue}
+{
+}
+
+bool HSVThreshold::contains(int blue, int green, int red) const
+{
+    int value{std::max(blue, std::max(green, red))};
+    int diff{value - std::min(blue, std::min(green, red))};
+
+    if (value < lowValue || value > highValue)
+        return false;
+
+    // Greys have no hue or saturation, which OpenCV reports as 0
+    if (diff == 0)
+        return lowSaturation <= 0 && highSaturation >= 0 && lowHue <= 0 && highHue >= 0;
+
+    int saturation{510 * diff};
+    if (saturation < (2 * lowSaturation - 1) * value || saturation >= (2 * highSaturation + 1) * value)
+        return false;
+
+    // Hue sector numerator, in units where 6 * diff is a full turn
+    // Negative reds only wrap around once they would no longer round to 0
+    int hue;
+    if (value == red)
+        hue = green - blue + (60 * (blue - green) > diff ? 6 * diff : 0);
+    else if (value == green)
+        hue = blue - red + 2 * diff;
+    else
+        hue = red - green + 4 * diff;
+
+    hue *= 60;
+    return hue >= (2 * lowHue - 1) * diff && hue < (2 * highHue + 1) * diff;
+}
+
+void HSVThreshold::apply(const cv::Mat &bgrFrame, cv::Mat &mask) const
+{
+    CV_Assert(bgrFrame.type() == CV_8UC3);
+    CV_Assert(mask.data != bgrFrame.data);
+
+    mask.create(bgrFrame.rows, bgrFrame.cols, CV_8UC1);
+
+    for (int y{0}; y < bgrFrame.rows; ++y)
+        applyRow(bgrFrame.ptr<uchar>(y), mask.ptr<uchar>(y), bgrFrame.cols);
+}
+
+void HSVThreshold::applyRow(const uchar *bgrRow, uchar *maskRow, int width) const
+{
+    int x{0};
+
+#if CV_SIMD128
+    const ThresholdLanes t{
+        cv::v_setall_f32(2 * lowHue - 1), cv::v_setall_f32(2 * highHue + 1),
+        cv::v_setall_f32(2 * lowSaturation - 1), cv::v_setall_f32(2 * highSaturation + 1),
+        cv::v_setall_f32(lowValue), cv::v_setall_f32(highValue),
+        cv::v_setall_f32(0), cv::v_setall_f32(2), cv::v_setall_f32(4), cv::v_setall_f32(6),
+        cv::v_setall_f32(60), cv::v_setall_f32(510),
+        cv::v_setall_u32(lowSaturation <= 0 && highSaturation >= 0 && lowHue <= 0 && highHue >= 0 ? 0xFFFFFFFF : 0),
+        cv::v_setall_u32(255)};
+
+    // 16 pixels per iteration, widened to four groups of 32-bit lanes
+    for (; x <= width - 16; x += 16)
+    {
+        cv::v_uint8x16 blue, green, red;
+        cv::v_load_deinterleave(bgrRow + x * 3, blue, green, red);
+
+        cv::v_uint16x8 blue16[2], green16[2], red16[2];
+        cv::v_expand(blue, blue16[0], blue16[1]);
+        cv::v_expand(green, green16[0], green16[1]);
+        cv::v_expand(red, red16[0], red16[1]);
+
+        cv::v_uint16x8 packed[2];
+        for (int half{0}; half < 2; ++half)
+        {
+            cv::v_uint32x4 blue32[2], green32[2], red32[2];
+            cv::v_expand(blue16[half], blue32[0], blue32[1]);
+            cv::v_expand(green16[half], green32[0], green32[1]);
+            cv::v_expand(red16[half], red32[0], red32[1]);
+
+            packed[half] = cv::v_pack(thresholdLanes(blue32[0], green32[0], red32[0], t),
+                                      thresholdLanes(blue32[1], green32[1], red32[1], t));
+        }
+
+        cv::v_store(maskRow + x, cv::v_pack(packed[0], packed[1]));
+    }
+#endif
+
+    for (; x < width; ++x)
+        maskRow[x] = contains(bgrRow[x * 3], bgrRow[x * 3 + 1], bgrRow[x * 3 + 2]) ? 255 : 0;
+}
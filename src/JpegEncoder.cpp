@@ -0,0 +1,178 @@
+#include "JpegEncoder.hpp"
+
+#include <algorithm>
+
+namespace
+{
+// libjpeg would print the error and exit, so print it and jump back to the encode call instead
+template <typename ErrorManager>
+void handleError(j_common_ptr compress)
+{
+    (*compress->err->output_message)(compress);
+    std::longjmp(reinterpret_cast<ErrorManager *>(compress->err)->jump, 1);
+}
+
+// Starts out big enough for most frames, and grows by doubling
+constexpr size_t initialOutputSize{64 * 1024};
+
+template <typename Destination>
+void initDestination(j_compress_ptr compress)
+{
+    Destination &destination{*reinterpret_cast<Destination *>(compress->dest)};
+    destination.output->resize(std::max(destination.output->capacity(), initialOutputSize));
+    destination.manager.next_output_byte = destination.output->data();
+    destination.manager.free_in_buffer = destination.output->size();
+}
+
+template <typename Destination>
+boolean growDestination(j_compress_ptr compress)
+{
+    Destination &destination{*reinterpret_cast<Destination *>(compress->dest)};
+    size_t used{destination.output->size()};
+    destination.output->resize(used * 2);
+    destination.manager.next_output_byte = destination.output->data() + used;
+    destination.manager.free_in_buffer = destination.output->size() - used;
+    return TRUE;
+}
+
+template <typename Destination>
+void terminateDestination(j_compress_ptr compress)
+{
+    Destination &destination{*reinterpret_cast<Destination *>(compress->dest)};
+    destination.output->resize(destination.output->size() - destination.manager.free_in_buffer);
+}
+} // namespace
+
+JpegEncoder::JpegEncoder()
+{
+    mCompress.err = jpeg_std_error(&mError.manager);
+    mError.manager.error_exit = &handleError<ErrorManager>;
+    jpeg_create_compress(&mCompress);
+
+    mDestination.manager.init_destination = &initDestination<Destination>;
+    mDestination.manager.empty_output_buffer = &growDestination<Destination>;
+    mDestination.manager.term_destination = &terminateDestination<Destination>;
+    mCompress.dest = &mDestination.manager;
+}
+
+JpegEncoder::~JpegEncoder()
+{
+    jpeg_destroy_compress(&mCompress);
+}
+
+void JpegEncoder::start(int width, int height, J_COLOR_SPACE colorSpace, int components, int quality, std::vector<uchar> &jpeg)
+{
+    mDestination.output = &jpeg;
+
+    mCompress.image_width = width;
+    mCompress.image_height = height;
+    mCompress.in_color_space = colorSpace;
+    mCompress.input_components = components;
+    jpeg_set_defaults(&mCompress);
+    jpeg_set_quality(&mCompress, quality, TRUE);
+
+    // Huffman tables tuned to the image aren't worth a second pass on a live stream
+    mCompress.optimize_coding = FALSE;
+    mCompress.dct_method = JDCT_IFAST;
+}
+
+bool JpegEncoder::encode(const cv::Mat &image, int quality, std::vector<uchar> &jpeg)
+{
+    const cv::Mat *input{&image};
+    J_COLOR_SPACE colorSpace;
+    if (image.type() == CV_8UC1)
+    {
+        colorSpace = JCS_GRAYSCALE;
+    }
+    else if (image.type() == CV_8UC3)
+    {
+#ifdef JCS_EXTENSIONS
+        colorSpace = JCS_EXT_BGR;
+#else
+        // Plain libjpeg only takes RGB
+        cv::cvtColor(image, mConverted, cv::COLOR_BGR2RGB);
+        input = &mConverted;
+        colorSpace = JCS_RGB;
+#endif
+    }
+    else
+    {
+        return false;
+    }
+
+    if (setjmp(mError.jump))
+    {
+        jpeg_abort_compress(&mCompress);
+        return false;
+    }
+
+    start(input->cols, input->rows, colorSpace, input->channels(), quality, jpeg);
+    jpeg_start_compress(&mCompress, TRUE);
+    while (mCompress.next_scanline < mCompress.image_height)
+    {
+        JSAMPROW row{const_cast<uchar *>(input->ptr<uchar>(mCompress.next_scanline))};
+        jpeg_write_scanlines(&mCompress, &row, 1);
+    }
+    jpeg_finish_compress(&mCompress);
+
+    return true;
+}
+
+bool JpegEncoder::encodeI420(const cv::Mat &i420, int quality, std::vector<uchar> &jpeg)
+{
+    int width{i420.cols};
+    int height{i420.rows * 2 / 3};
+
+    // libjpeg reads whole 16 pixel blocks, which would run off the end of narrower rows
+    if (i420.type() != CV_8UC1 || !i420.isContinuous() || width % 16 != 0 || height % 2 != 0)
+    {
+        if (i420.type() != CV_8UC1)
+            return false;
+
+        cv::cvtColor(i420, mConverted, cv::COLOR_YUV2BGR_I420);
+        return encode(mConverted, quality, jpeg);
+    }
+
+    const uchar *yPlane{i420.data};
+    const uchar *uPlane{yPlane + width * height};
+    const uchar *vPlane{uPlane + width * height / 4};
+
+    if (setjmp(mError.jump))
+    {
+        jpeg_abort_compress(&mCompress);
+        return false;
+    }
+
+    start(width, height, JCS_YCbCr, 3, quality, jpeg);
+    mCompress.raw_data_in = TRUE;
+    mCompress.comp_info[0].h_samp_factor = 2;
+    mCompress.comp_info[0].v_samp_factor = 2;
+    mCompress.comp_info[1].h_samp_factor = 1;
+    mCompress.comp_info[1].v_samp_factor = 1;
+    mCompress.comp_info[2].h_samp_factor = 1;
+    mCompress.comp_info[2].v_samp_factor = 1;
+
+    jpeg_start_compress(&mCompress, TRUE);
+
+    // Sixteen luma rows and eight of each chroma row at a time, repeating the last row past the bottom
+    JSAMPROW yRows[16], uRows[8], vRows[8];
+    JSAMPARRAY planes[3]{yRows, uRows, vRows};
+    while (mCompress.next_scanline < mCompress.image_height)
+    {
+        for (int row{0}; row < 16; ++row)
+        {
+            int y{std::min(static_cast<int>(mCompress.next_scanline) + row, height - 1)};
+            yRows[row] = const_cast<uchar *>(yPlane + y * width);
+        }
+        for (int row{0}; row < 8; ++row)
+        {
+            int y{std::min(static_cast<int>(mCompress.next_scanline) / 2 + row, height / 2 - 1)};
+            uRows[row] = const_cast<uchar *>(uPlane + y * width / 2);
+            vRows[row] = const_cast<uchar *>(vPlane + y * width / 2);
+        }
+        jpeg_write_raw_data(&mCompress, planes, 16);
+    }
+    jpeg_finish_compress(&mCompress);
+
+    return true;
+}
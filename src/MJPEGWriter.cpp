@@ -1,129 +1,541 @@
 #include "MJPEGWriter/MJPEGWriter.h"
-#include <fstream>
-void
-MJPEGWriter::Listener()
-{
-
-	// send http header
-    std::string header;
-    header += "HTTP/1.0 200 OK\r\n";
-    header += "Cache-Control: no-cache\r\n";
-    header += "Pragma: no-cache\r\n";
-    header += "Connection: close\r\n";
-    header += "Content-Type: multipart/x-mixed-replace; boundary=mjpegstream\r\n\r\n";
-    const int header_size = header.size();
-    char* header_data = (char*)header.data();
-    fd_set rread;
-    SOCKET maxfd;
-    this->open();
-    pthread_mutex_unlock(&mutex_writer);
-    while (!stopFlag)
-    {
-        rread = master;
-        struct timeval to = { 0, timeout };
-        maxfd = sock + 1;
-
-        int sel = select(maxfd, &rread, NULL, NULL, &to);
-        if (sel > 0) {
-            for (int s = 0; s < maxfd; s++)
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace
+{
+const std::string responseHeader{"HTTP/1.0 200 OK\r\n"
+                                 "Cache-Control: no-cache\r\n"
+                                 "Pragma: no-cache\r\n"
+                                 "Connection: close\r\n"
+                                 "Content-Type: multipart/x-mixed-replace; boundary=mjpegstream\r\n\r\n"};
+
+// Requests are only a few hundred bytes, so anything longer isn't a browser
+constexpr size_t maxRequestSize{4096};
+
+// Returns the value of key in the request line's query string, or fallback if it isn't there
+int getQueryValue(const std::string &request, const std::string &key, int fallback)
+{
+    size_t query{request.find('?')};
+    size_t lineEnd{request.find_first_of(" \r\n", query)};
+    if (query == std::string::npos || query > request.find('\n'))
+        return fallback;
+
+    for (size_t start{query + 1}; start < lineEnd;)
+    {
+        size_t end{std::min(request.find('&', start), lineEnd)};
+        if (request.compare(start, key.size() + 1, key + '=') == 0)
+            return std::atoi(request.c_str() + start + key.size() + 1);
+        start = end + 1;
+    }
+
+    return fallback;
+}
+} // namespace
+
+MJPEGWriter::MJPEGWriter(int port) : mPort{port}
+{
+}
+
+MJPEGWriter::~MJPEGWriter()
+{
+    stop();
+}
+
+void MJPEGWriter::start()
+{
+    if (mThread.joinable() || !open())
+        return;
+
+    mStopFlag = false;
+    mThread = std::thread{&MJPEGWriter::run, this};
+}
+
+void MJPEGWriter::stop()
+{
+    mStopFlag = true;
+    if (mThread.joinable())
+    {
+        uint64_t wake{1};
+        ::write(mWakeEvent, &wake, sizeof(wake));
+        mThread.join();
+    }
+
+    release();
+}
+
+bool MJPEGWriter::isOpened()
+{
+    return mListenSocket != -1;
+}
+
+void MJPEGWriter::write(const cv::Mat &frame)
+{
+    if (frame.empty())
+        return;
+
+    // The serving thread never touches the back buffer, so the copy happens outside the frame lock
+    std::lock_guard<std::mutex> lock{mWriteMutex};
+    int scale{mScale};
+    if (scale > 1)
+        cv::resize(frame, mBackFrame, cv::Size{frame.cols / scale, frame.rows / scale}, 0, 0, cv::INTER_AREA);
+    else
+        frame.copyTo(mBackFrame);
+    mBackFormat = image;
+
+    publishBackFrame();
+}
+
+void MJPEGWriter::writeI420(const cv::Mat &frame)
+{
+    if (frame.empty())
+        return;
+
+    std::lock_guard<std::mutex> lock{mWriteMutex};
+    int scale{mScale};
+    if (scale > 1)
+    {
+        // Each plane is scaled on its own, keeping chroma at half the luma size
+        int width{frame.cols}, height{frame.rows * 2 / 3};
+        int scaledWidth{width / scale / 2 * 2}, scaledHeight{height / scale / 2 * 2};
+        mBackFrame.create(scaledHeight * 3 / 2, scaledWidth, CV_8UC1);
+
+        const uchar *source{frame.data};
+        uchar *destination{mBackFrame.data};
+        cv::resize(cv::Mat{height, width, CV_8UC1, const_cast<uchar *>(source)}, cv::Mat{scaledHeight, scaledWidth, CV_8UC1, destination},
+                   cv::Size{scaledWidth, scaledHeight}, 0, 0, cv::INTER_AREA);
+        source += width * height;
+        destination += scaledWidth * scaledHeight;
+        for (int plane{0}; plane < 2; ++plane)
+        {
+            cv::Mat scaledPlane{scaledHeight / 2, scaledWidth / 2, CV_8UC1, destination};
+            cv::resize(cv::Mat{height / 2, width / 2, CV_8UC1, const_cast<uchar *>(source)}, scaledPlane, scaledPlane.size(), 0, 0, cv::INTER_AREA);
+            source += width * height / 4;
+            destination += scaledWidth * scaledHeight / 4;
+        }
+    }
+    else
+    {
+        frame.copyTo(mBackFrame);
+    }
+    mBackFormat = i420;
+
+    publishBackFrame();
+}
+
+void MJPEGWriter::writeJpeg(const cv::Mat &jpeg)
+{
+    if (jpeg.empty())
+        return;
+
+    std::lock_guard<std::mutex> lock{mWriteMutex};
+    jpeg.copyTo(mBackFrame);
+    mBackFormat = passthrough;
+
+    publishBackFrame();
+}
+
+void MJPEGWriter::setScale(int divisor)
+{
+    mScale = std::max(divisor, 1);
+}
+
+void MJPEGWriter::setMetrics(Metrics *metrics)
+{
+    mMetrics = metrics;
+}
+
+void MJPEGWriter::publishBackFrame()
+{
+    {
+        std::lock_guard<std::mutex> lock{mFrameMutex};
+        std::swap(mBackFrame, mMiddleFrame);
+        std::swap(mBackFormat, mMiddleFormat);
+        ++mMiddleGeneration;
+    }
+
+    if (mWakeEvent != -1)
+    {
+        uint64_t wake{1};
+        ::write(mWakeEvent, &wake, sizeof(wake));
+    }
+}
+
+bool MJPEGWriter::open()
+{
+    mListenSocket = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, IPPROTO_TCP);
+    if (mListenSocket == -1)
+    {
+        std::cout << "Could not create MJPEG socket\n";
+        return false;
+    }
+
+    // Lets us immediately rebind to the port after termination
+    int reuseAddress{1};
+    setsockopt(mListenSocket, SOL_SOCKET, SO_REUSEADDR, &reuseAddress, sizeof(reuseAddress));
+
+    sockaddr_in address{};
+    address.sin_addr.s_addr = INADDR_ANY;
+    address.sin_family = AF_INET;
+    address.sin_port = htons(mPort);
+
+    if (bind(mListenSocket, reinterpret_cast<sockaddr *>(&address), sizeof(address)) == -1 || listen(mListenSocket, SOMAXCONN) == -1)
+    {
+        std::cout << "Could not listen for MJPEG clients on port " << mPort << '\n';
+        release();
+        return false;
+    }
+
+    mEpoll = epoll_create1(0);
+    mWakeEvent = eventfd(0, EFD_NONBLOCK);
+
+    // The listening socket and the wake event are told apart from clients by what their data points to
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.ptr = nullptr;
+    epoll_ctl(mEpoll, EPOLL_CTL_ADD, mListenSocket, &event);
+    event.data.ptr = &mWakeEvent;
+    epoll_ctl(mEpoll, EPOLL_CTL_ADD, mWakeEvent, &event);
+
+    return true;
+}
+
+void MJPEGWriter::release()
+{
+    for (std::unique_ptr<Client> &client : mClients)
+        disconnect(*client);
+    mClients.clear();
+    mNewestFrames.clear();
+
+    for (int *descriptor : {&mEpoll, &mWakeEvent, &mListenSocket})
+    {
+        if (*descriptor != -1)
+            close(*descriptor);
+        *descriptor = -1;
+    }
+}
+
+void MJPEGWriter::run()
+{
+    std::vector<epoll_event> events(64);
+
+    while (!mStopFlag)
+    {
+        // Sleeps until a socket is ready, a frame arrives, or the next rate-limited client is due
+        std::chrono::steady_clock::time_point now{std::chrono::steady_clock::now()};
+        int timeout{-1};
+        for (std::unique_ptr<Client> &client : mClients)
+        {
+            if (client->socket != -1 && client->streaming && !client->frame && client->nextFrameTime > now)
+            {
+                int untilDue{static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(client->nextFrameTime - now).count()) + 1};
+                timeout = timeout == -1 ? untilDue : std::min(timeout, untilDue);
+            }
+        }
+
+        int ready{epoll_wait(mEpoll, events.data(), events.size(), timeout)};
+
+        for (int e{0}; e < ready; ++e)
+        {
+            if (events[e].data.ptr == nullptr)
+            {
+                acceptClients();
+                continue;
+            }
+            if (events[e].data.ptr == &mWakeEvent)
             {
-                if (FD_ISSET(s, &rread) && s == sock)
-                {
-                    int         addrlen = sizeof(SOCKADDR);
-                    SOCKADDR_IN address = { 0 };
-                    SOCKET      client = accept(sock, (SOCKADDR*)&address, (socklen_t*)&addrlen);
-                    if (client == SOCKET_ERROR)
-                    {
-                        cerr << "error : couldn't accept connection on sock " << sock << " !" << endl;
-                        return;
-                    }
-                    maxfd = (maxfd>client ? maxfd : client);
-                    pthread_mutex_lock(&mutex_cout);
-                    cout << "new client " << client << endl;
-                    char headers[4096] = "\0";
-                    int readBytes = _read(client, headers);
-                    cout << headers;
-                    pthread_mutex_unlock(&mutex_cout);
-                    pthread_mutex_lock(&mutex_client);
-                    _write(client, header_data, header_size);
-                    clients.push_back(client);
-                    pthread_mutex_unlock(&mutex_client);
-                }
+                uint64_t wakes;
+                ::read(mWakeEvent, &wakes, sizeof(wakes));
+                continue;
             }
+
+            Client *client{static_cast<Client *>(events[e].data.ptr)};
+            if (events[e].events & (EPOLLERR | EPOLLHUP))
+                disconnect(*client);
+            if (client->socket != -1 && events[e].events & EPOLLIN)
+                readRequest(*client);
+            if (client->socket != -1 && events[e].events & EPOLLOUT)
+                sendPending(*client);
         }
-        usleep(1000);
+
+        // Clients still busy with an older frame pick up the new one when they finish
+        now = std::chrono::steady_clock::now();
+        for (std::unique_ptr<Client> &client : mClients)
+            serve(*client, now);
+
+        mClients.erase(std::remove_if(mClients.begin(), mClients.end(), [](const std::unique_ptr<Client> &client) {
+                           return client->socket == -1;
+                       }),
+                       mClients.end());
+
+        dropUnwatchedFrames();
+    }
+}
+
+void MJPEGWriter::acceptClients()
+{
+    while (true)
+    {
+        int socket{accept4(mListenSocket, nullptr, nullptr, SOCK_NONBLOCK)};
+        if (socket == -1)
+            return;
+
+        mClients.push_back(std::unique_ptr<Client>{new Client{}});
+        Client &client{*mClients.back()};
+        client.socket = socket;
+
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.ptr = &client;
+        epoll_ctl(mEpoll, EPOLL_CTL_ADD, socket, &event);
     }
 }
 
-void
-MJPEGWriter::Writer()
+void MJPEGWriter::readRequest(Client &client)
 {
-    pthread_mutex_lock(&mutex_writer);
-    pthread_mutex_unlock(&mutex_writer);
-    const int milis2wait = 16666;
-    while (this->isOpened() && !stopFlag)
+    char buffer[1024];
+    while (true)
     {
-        pthread_mutex_lock(&mutex_client);
-        int num_connected_clients = clients.size();
-        pthread_mutex_unlock(&mutex_client);
-        if (!num_connected_clients) {
-            usleep(milis2wait);
+        ssize_t received{recv(client.socket, buffer, sizeof(buffer), 0)};
+        if (received == 0 || (received == -1 && errno != EAGAIN && errno != EWOULDBLOCK))
+        {
+            disconnect(client);
+            return;
+        }
+        if (received == -1)
+            return;
+
+        // Whatever a client sends once it's streaming is ignored
+        if (client.streaming)
             continue;
+
+        client.request.append(buffer, received);
+        if (client.request.find("\r\n\r\n") != std::string::npos)
+        {
+            startStreaming(client);
+            if (client.socket == -1)
+                return;
+        }
+        else if (client.request.size() > maxRequestSize)
+        {
+            disconnect(client);
+            return;
+        }
+    }
+}
+
+void MJPEGWriter::startStreaming(Client &client)
+{
+    client.quality = std::min(std::max(getQueryValue(client.request, "q", mQuality), 1), 100);
+
+    int fps{getQueryValue(client.request, "fps", 0)};
+    client.frameInterval = fps > 0 ? std::chrono::steady_clock::duration{std::chrono::seconds{1}} / fps : std::chrono::steady_clock::duration{0};
+
+    client.request.clear();
+    client.request.shrink_to_fit();
+    client.streaming = true;
+    client.response = responseHeader;
+    client.sent = 0;
+    sendPending(client);
+}
+
+void MJPEGWriter::serve(Client &client, std::chrono::steady_clock::time_point now)
+{
+    if (client.socket == -1 || !client.streaming || client.frame || !client.response.empty() || now < client.nextFrameTime)
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock{mFrameMutex};
+        if (mMiddleGeneration == client.lastGeneration)
+            return;
+
+        if (mMiddleGeneration != mFrontGeneration)
+        {
+            std::swap(mMiddleFrame, mFrontFrame);
+            std::swap(mMiddleFormat, mFrontFormat);
+            mFrontGeneration = mMiddleGeneration;
+        }
+    }
+
+    client.frame = getFrame(client.quality);
+    if (!client.frame)
+    {
+        // Waits for the next frame rather than trying to encode this one again
+        client.lastGeneration = mFrontGeneration;
+        return;
+    }
+    client.sent = 0;
+    client.lastGeneration = client.frame->generation;
+
+    // Keeps to the client's rate without drifting, unless it fell so far behind it would burst to catch up
+    client.nextFrameTime = std::max(client.nextFrameTime + client.frameInterval, now);
+
+    sendPending(client);
+}
+
+std::shared_ptr<MJPEGWriter::EncodedFrame> MJPEGWriter::getFrame(int quality)
+{
+    // Frames that came encoded are served as they are, whatever quality was asked for
+    if (mFrontFormat == passthrough)
+        quality = 0;
+
+    for (std::shared_ptr<EncodedFrame> &frame : mNewestFrames)
+    {
+        if (frame->quality == quality && frame->generation == mFrontGeneration)
+            return frame;
+    }
+
+    std::shared_ptr<EncodedFrame> slot{getFreeSlot()};
+    std::chrono::steady_clock::time_point encodeStart{std::chrono::steady_clock::now()};
+    bool encoded{true};
+    if (mFrontFormat == i420)
+        encoded = mEncoder.encodeI420(mFrontFrame, quality, slot->jpeg);
+    else if (mFrontFormat == image)
+        encoded = mEncoder.encode(mFrontFrame, quality, slot->jpeg);
+    else
+        slot->jpeg.assign(mFrontFrame.data, mFrontFrame.data + mFrontFrame.cols);
+
+    // The slot still holds whatever it last held, so it goes back unused rather than out under a new header
+    if (!encoded)
+        return nullptr;
+
+    Metrics *metrics{mMetrics};
+    if (metrics != nullptr)
+    {
+        if (mFrontFormat != passthrough)
+            metrics->record(Metrics::encode, std::chrono::steady_clock::now() - encodeStart);
+        metrics->recordEncodedBytes(slot->jpeg.size());
+    }
+    slot->header = "--mjpegstream\r\nContent-Type: image/jpeg\r\nContent-Length: " + std::to_string(slot->jpeg.size()) + "\r\n\r\n";
+    slot->generation = mFrontGeneration;
+    slot->quality = quality;
+
+    // Replaces the older frame at this quality, if there was one
+    for (std::shared_ptr<EncodedFrame> &frame : mNewestFrames)
+    {
+        if (frame->quality == quality)
+        {
+            frame = slot;
+            return slot;
         }
-        pthread_t threads[NUM_CONNECTIONS];
-        int count = 0;
-
-        std::vector<uchar> outbuf;
-        std::vector<int> params;
-        params.push_back(CV_IMWRITE_JPEG_QUALITY);
-        params.push_back(quality);
-        pthread_mutex_lock(&mutex_writer);
-        imencode(".jpg", lastFrame, outbuf, params);
-        pthread_mutex_unlock(&mutex_writer);
-        int outlen = outbuf.size();
-
-        pthread_mutex_lock(&mutex_client);
-        std::vector<int>::iterator begin = clients.begin();
-        std::vector<int>::iterator end = clients.end();
-        pthread_mutex_unlock(&mutex_client);
-        std::vector<clientPayload*> payloads;
-        for (std::vector<int>::iterator it = begin; it != end; ++it, ++count)
+    }
+
+    mNewestFrames.push_back(slot);
+    return slot;
+}
+
+void MJPEGWriter::dropUnwatchedFrames()
+{
+    // Passed-through frames are served whatever quality a client asked for
+    mNewestFrames.erase(std::remove_if(mNewestFrames.begin(), mNewestFrames.end(), [this](const std::shared_ptr<EncodedFrame> &frame) {
+                            return std::none_of(mClients.begin(), mClients.end(), [&frame](const std::unique_ptr<Client> &client) {
+                                return client->streaming && (frame->quality == 0 || client->quality == frame->quality);
+                            });
+                        }),
+                        mNewestFrames.end());
+}
+
+void MJPEGWriter::sendPending(Client &client)
+{
+    while (client.socket != -1 && (!client.response.empty() || client.frame))
+    {
+        iovec parts[2];
+        int partCount{0};
+        size_t total{0};
+
+        if (!client.response.empty())
         {
-            if (count > NUM_CONNECTIONS)
-                break;
-            struct clientPayload *cp = new clientPayload({ (MJPEGWriter*)this, { outbuf.data(), outlen, *it } });
-            payloads.push_back(cp);
-            pthread_create(&threads[count], NULL, &MJPEGWriter::clientWrite_Helper, cp);
+            parts[partCount++] = iovec{&client.response[client.sent], client.response.size() - client.sent};
+            total = client.response.size();
         }
-        for (; count > 0; count--)
+        else
         {
-            pthread_join(threads[count-1], NULL);
-            delete payloads.at(count-1);
+            const EncodedFrame &frame{*client.frame};
+            if (client.sent < frame.header.size())
+            {
+                parts[partCount++] = iovec{const_cast<char *>(frame.header.data()) + client.sent, frame.header.size() - client.sent};
+                parts[partCount++] = iovec{const_cast<uchar *>(frame.jpeg.data()), frame.jpeg.size()};
+            }
+            else
+            {
+                size_t jpegSent{client.sent - frame.header.size()};
+                parts[partCount++] = iovec{const_cast<uchar *>(frame.jpeg.data()) + jpegSent, frame.jpeg.size() - jpegSent};
+            }
+            total = frame.size();
         }
-        usleep(milis2wait);
-    }
-}
-
-void
-MJPEGWriter::ClientWrite(clientFrame & cf)
-{
-    stringstream head;
-    head << "--mjpegstream\r\nContent-Type: image/jpeg\r\nContent-Length: " << cf.outlen << "\r\n\r\n";
-    string string_head = head.str();
-    pthread_mutex_lock(&mutex_client);
-    _write(cf.client, (char*) string_head.c_str(), string_head.size());
-    int n = _write(cf.client, (char*)(cf.outbuf), cf.outlen);
-	if (n < cf.outlen)
-	{
-    	std::vector<int>::iterator it;
-      	it = find (clients.begin(), clients.end(), cf.client);
-      	if (it != clients.end())
-      	{
-      		cerr << "kill client " << cf.client << endl;
-      		clients.erase(std::remove(clients.begin(), clients.end(), cf.client));
-            	::shutdown(cf.client, 2);
-      	}
-	}
-    pthread_mutex_unlock(&mutex_client);
-    pthread_exit(NULL);
+
+        msghdr message{};
+        message.msg_iov = parts;
+        message.msg_iovlen = partCount;
+        ssize_t written{sendmsg(client.socket, &message, MSG_NOSIGNAL | MSG_DONTWAIT)};
+
+        if (written == -1)
+        {
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                watchWritable(client, true);
+            else
+                disconnect(client);
+            return;
+        }
+
+        client.sent += written;
+        if (client.sent < total)
+            continue;
+
+        client.sent = 0;
+        if (!client.response.empty())
+            client.response.clear();
+        else
+            client.frame.reset();
+    }
+
+    if (client.socket != -1)
+        watchWritable(client, false);
+}
+
+void MJPEGWriter::watchWritable(Client &client, bool writable)
+{
+    if (client.waitingToWrite == writable)
+        return;
+
+    epoll_event event{};
+    event.events = EPOLLIN | (writable ? EPOLLOUT : 0);
+    event.data.ptr = &client;
+    epoll_ctl(mEpoll, EPOLL_CTL_MOD, client.socket, &event);
+    client.waitingToWrite = writable;
+}
+
+void MJPEGWriter::disconnect(Client &client)
+{
+    if (client.socket == -1)
+        return;
+
+    epoll_ctl(mEpoll, EPOLL_CTL_DEL, client.socket, nullptr);
+    close(client.socket);
+    client.socket = -1;
+    client.frame.reset();
+}
+
+std::shared_ptr<MJPEGWriter::EncodedFrame> MJPEGWriter::getFreeSlot()
+{
+    // Everything runs on one thread, so a count of one means only the slot list still holds it
+    for (std::shared_ptr<EncodedFrame> &slot : mFrameSlots)
+    {
+        if (slot.use_count() == 1)
+            return slot;
+    }
+
+    mFrameSlots.push_back(std::make_shared<EncodedFrame>());
+    return mFrameSlots.back();
 }
@@ -0,0 +1,199 @@
+#include "MaskOpening.hpp"
+
+#include <cstring>
+#include <opencv2/core/hal/intrin.hpp>
+
+namespace
+{
+constexpr int bitsPerWord{64};
+
+// Gathers the top bits of 8 bytes into one byte, first byte in the lowest bit
+// Every byte's bit lands in a different place, so nothing carries into the top byte
+inline uint64_t packBytes(const uchar *pixels)
+{
+    uint64_t bytes;
+    std::memcpy(&bytes, pixels, sizeof(bytes));
+    return (((bytes >> 7) & 0x0101010101010101ull) * 0x0102040810204080ull) >> 56;
+}
+
+inline uint64_t packWord(const uchar *pixels)
+{
+    uint64_t packed{0};
+#if CV_SIMD128
+    // One movemask per 16 pixels
+    for (int shift{0}; shift < bitsPerWord; shift += 16)
+        packed |= static_cast<uint64_t>(cv::v_signmask(cv::v_load(pixels + shift))) << shift;
+#else
+    for (int shift{0}; shift < bitsPerWord; shift += 8)
+        packed |= packBytes(pixels + shift) << shift;
+#endif
+    return packed;
+}
+
+// The 8 bytes of 0 and 255 each byte value unpacks to
+class UnpackTable
+{
+public:
+    uint64_t bytes[256];
+
+    UnpackTable()
+    {
+        for (int value{0}; value < 256; ++value)
+        {
+            uchar pixels[8];
+            for (int bit{0}; bit < 8; ++bit)
+                pixels[bit] = (value >> bit & 1) ? 255 : 0;
+            std::memcpy(&bytes[value], pixels, sizeof(uint64_t));
+        }
+    }
+};
+
+const UnpackTable unpackTable;
+
+void packRow(const uchar *pixels, int width, uint64_t *words)
+{
+    int x{0}, word{0};
+    for (; x + bitsPerWord <= width; x += bitsPerWord, ++word)
+        words[word] = packWord(pixels + x);
+
+    if (x < width)
+    {
+        uint64_t packed{0};
+        for (int shift{0}; x < width; ++shift, ++x)
+            packed |= static_cast<uint64_t>(pixels[x] != 0) << shift;
+        words[word] = packed;
+    }
+}
+
+void unpackRow(const uint64_t *words, int width, uchar *pixels)
+{
+    int x{0}, word{0};
+    for (; x + bitsPerWord <= width; x += bitsPerWord, ++word)
+    {
+        // Most of a mask is empty
+        if (words[word] == 0)
+        {
+            std::memset(pixels + x, 0, bitsPerWord);
+            continue;
+        }
+
+        for (int shift{0}; shift < bitsPerWord; shift += 8)
+            std::memcpy(pixels + x + shift, &unpackTable.bytes[words[word] >> shift & 0xff], 8);
+    }
+
+    for (int shift{0}; x < width; ++shift, ++x)
+        pixels[x] = (words[word] >> shift & 1) ? 255 : 0;
+}
+
+// Erodes or dilates the center row by the cross, which is the row itself, its neighbours on either side and the rows
+// above and below. A pixel's left neighbour is the bit below it, carrying across words
+template <bool erode>
+void combineRows(const uint64_t *above, const uint64_t *center, const uint64_t *below, uint64_t *output, int words)
+{
+    constexpr uint64_t outside{erode ? ~0ull : 0};
+    for (int w{0}; w < words; ++w)
+    {
+        uint64_t previous{w == 0 ? outside : center[w - 1]};
+        uint64_t next{w == words - 1 ? outside : center[w + 1]};
+        uint64_t left{center[w] << 1 | previous >> 63};
+        uint64_t right{center[w] >> 1 | next << 63};
+
+        if (erode)
+            output[w] = center[w] & left & right & above[w] & below[w];
+        else
+            output[w] = center[w] | left | right | above[w] | below[w];
+    }
+}
+} // namespace
+
+void MaskOpening::apply(cv::Mat &mask, int passes)
+{
+    CV_Assert(mask.type() == CV_8UC1);
+
+    if (passes <= 0 || mask.empty())
+        return;
+
+    resize(mask.cols, passes);
+    mMask = &mask;
+    mNextOutputRow = 0;
+
+    std::vector<uint64_t> &input{mStages[0].output};
+    for (int y{0}; y < mask.rows; ++y)
+    {
+        // The first stage's output row is free until it has rows to erode, so it doubles as the packing buffer
+        packRow(mask.ptr<uchar>(y), mask.cols, input.data());
+        feed(0, input.data());
+    }
+
+    // Each stage in turn sees the row past the bottom edge, which flushes its last row down the chain
+    for (int stage{0}; stage < mStageCount; ++stage)
+        feed(stage, nullptr);
+
+    mMask = nullptr;
+}
+
+void MaskOpening::resize(int width, int passes)
+{
+    mStageCount = 2 * passes;
+    mWords = (width + bitsPerWord - 1) / bitsPerWord;
+    mPadding = width % bitsPerWord == 0 ? 0 : ~0ull << width % bitsPerWord;
+
+    if (static_cast<int>(mStages.size()) < mStageCount)
+        mStages.resize(mStageCount);
+
+    for (int s{0}; s < mStageCount; ++s)
+    {
+        Stage &stage{mStages[s]};
+        stage.erode = s < passes;
+        stage.rows.resize(4 * mWords);
+        std::fill(stage.rows.begin() + 3 * mWords, stage.rows.end(), stage.erode ? ~0ull : 0);
+        stage.output.resize(mWords);
+        stage.received = 0;
+    }
+}
+
+void MaskOpening::feed(int s, const uint64_t *row)
+{
+    for (; s < mStageCount; ++s)
+    {
+        Stage &stage{mStages[s]};
+
+        // Pixels past the edges never erode anything or dilate into anything
+        uint64_t outside{stage.erode ? ~0ull : 0};
+
+        uint64_t *stored{stage.rows.data() + stage.received % 3 * mWords};
+        if (row == nullptr)
+        {
+            std::fill(stored, stored + mWords, outside);
+        }
+        else
+        {
+            // Copied before writing output, which may be what row points to
+            std::copy(row, row + mWords, stored);
+            if (stage.erode)
+                stored[mWords - 1] |= mPadding;
+            else
+                stored[mWords - 1] &= ~mPadding;
+        }
+        ++stage.received;
+
+        // Row r needs rows r - 1 to r + 1
+        int r{stage.received - 2};
+        if (r < 0)
+            return;
+
+        // The row above the top edge is the fourth one, which is always outside
+        const uint64_t *center{stage.rows.data() + r % 3 * mWords};
+        const uint64_t *below{stage.rows.data() + (r + 1) % 3 * mWords};
+        const uint64_t *above{stage.rows.data() + (r == 0 ? 3 : (r + 2) % 3) * mWords};
+
+        if (stage.erode)
+            combineRows<true>(above, center, below, stage.output.data(), mWords);
+        else
+            combineRows<false>(above, center, below, stage.output.data(), mWords);
+
+        row = stage.output.data();
+    }
+
+    unpackRow(row, mMask->cols, mMask->ptr<uchar>(mNextOutputRow++));
+}
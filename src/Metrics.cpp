@@ -0,0 +1,143 @@
+#include "Metrics.hpp"
+
+#include <algorithm>
+#include <yaml-cpp/yaml.h>
+
+namespace
+{
+int log2(uint64_t value)
+{
+    int log{0};
+    while (value >>= 1)
+        ++log;
+    return log;
+}
+} // namespace
+
+void LatencyHistogram::record(std::chrono::nanoseconds latency)
+{
+    uint64_t nanoseconds{static_cast<uint64_t>(std::max<int64_t>(latency.count(), 0))};
+
+    mBuckets[bucketOf(nanoseconds / 1000)].fetch_add(1, std::memory_order_relaxed);
+    mTotalNanoseconds.fetch_add(nanoseconds, std::memory_order_relaxed);
+    mCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+void LatencyHistogram::reset()
+{
+    for (std::atomic<uint32_t> &bucket : mBuckets)
+        bucket.store(0, std::memory_order_relaxed);
+    mTotalNanoseconds.store(0, std::memory_order_relaxed);
+    mCount.store(0, std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::getCount() const
+{
+    return mCount.load(std::memory_order_relaxed);
+}
+
+double LatencyHistogram::getMeanMilliseconds() const
+{
+    uint64_t count{getCount()};
+    return count == 0 ? 0 : mTotalNanoseconds.load(std::memory_order_relaxed) / 1e6 / count;
+}
+
+double LatencyHistogram::getPercentileMilliseconds(double fraction) const
+{
+    // Sums the buckets rather than trusting mCount, which a concurrent record() may have bumped already
+    std::array<uint32_t, buckets> counts;
+    uint64_t count{0};
+    for (int bucket{0}; bucket < buckets; ++bucket)
+    {
+        counts[bucket] = mBuckets[bucket].load(std::memory_order_relaxed);
+        count += counts[bucket];
+    }
+
+    if (count == 0)
+        return 0;
+
+    uint64_t target{static_cast<uint64_t>(fraction * (count - 1)) + 1};
+    uint64_t seen{0};
+    for (int bucket{0}; bucket < buckets; ++bucket)
+    {
+        seen += counts[bucket];
+        if (seen >= target)
+            return upperEdgeOf(bucket) / 1000.0;
+    }
+
+    return upperEdgeOf(buckets - 1) / 1000.0;
+}
+
+int LatencyHistogram::bucketOf(uint64_t microseconds)
+{
+    // 0-3 us get a bucket each, then each power of two is split in four by the next two bits
+    if (microseconds < 4)
+        return microseconds;
+
+    int exponent{log2(microseconds)};
+    int bucket{4 * (exponent - 1) + static_cast<int>((microseconds >> (exponent - 2)) & 3)};
+    return std::min(bucket, buckets - 1);
+}
+
+uint64_t LatencyHistogram::upperEdgeOf(int bucket)
+{
+    if (bucket < 4)
+        return bucket + 1;
+
+    int exponent{bucket / 4 + 1};
+    return static_cast<uint64_t>(5 + bucket % 4) << (exponent - 2);
+}
+
+const char *Metrics::getStageName(Stage stage)
+{
+    static const char *names[stageCount]{"capture", "segment", "morphology", "contours", "validation", "pairing", "send", "overlay", "encode", "total"};
+    return names[stage];
+}
+
+void Metrics::record(Stage stage, std::chrono::nanoseconds latency)
+{
+    mHistograms[stage].record(latency);
+}
+
+void Metrics::recordEncodedBytes(size_t bytes)
+{
+    mEncodedBytes.fetch_add(bytes, std::memory_order_relaxed);
+    mEncodedFrames.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Metrics::reset()
+{
+    for (LatencyHistogram &histogram : mHistograms)
+        histogram.reset();
+    mEncodedBytes.store(0, std::memory_order_relaxed);
+    mEncodedFrames.store(0, std::memory_order_relaxed);
+}
+
+const LatencyHistogram &Metrics::getHistogram(Stage stage) const
+{
+    return mHistograms[stage];
+}
+
+std::string Metrics::getReport() const
+{
+    YAML::Node report;
+    for (int stage{0}; stage < stageCount; ++stage)
+    {
+        const LatencyHistogram &histogram{mHistograms[stage]};
+        YAML::Node stageReport{report[getStageName(static_cast<Stage>(stage))]};
+        stageReport["count"] = histogram.getCount();
+        stageReport["meanMs"] = histogram.getMeanMilliseconds();
+        stageReport["p50Ms"] = histogram.getPercentileMilliseconds(0.5);
+        stageReport["p99Ms"] = histogram.getPercentileMilliseconds(0.99);
+    }
+
+    uint64_t encodedFrames{mEncodedFrames.load(std::memory_order_relaxed)};
+    report["encodedBytes"]["count"] = encodedFrames;
+    report["encodedBytes"]["mean"] = encodedFrames == 0 ? 0 : mEncodedBytes.load(std::memory_order_relaxed) / encodedFrames;
+
+    YAML::Emitter reportEmitter;
+    reportEmitter.SetMapFormat(YAML::Block);
+    reportEmitter << report;
+
+    return reportEmitter.c_str();
+}
@@ -0,0 +1,83 @@
+#include "PipelineExecutor.hpp"
+
+PipelineExecutor::PipelineExecutor(std::vector<Stage> stages)
+    : mStages{stages}, mFrames(stages.size() + 2)
+{
+    for (size_t stage{0}; stage < mStages.size(); ++stage)
+        mQueues.push_back(std::unique_ptr<SPSCQueue<VisionFrame *>>{new SPSCQueue<VisionFrame *>{mFrames.size()}});
+
+    // Every frame starts out free for the first stage to fill
+    for (VisionFrame &frame : mFrames)
+        mQueues.front()->push(&frame);
+}
+
+void PipelineExecutor::run(const std::atomic<bool> &stopFlag)
+{
+    std::vector<std::unique_ptr<StageThread>> stageThreads;
+    for (size_t stage{1}; stage < mStages.size(); ++stage)
+        stageThreads.push_back(std::unique_ptr<StageThread>{new StageThread{*this, static_cast<int>(stage)}});
+
+    runStage(0, stopFlag);
+
+    for (std::unique_ptr<StageThread> &stageThread : stageThreads)
+        stageThread->stop();
+}
+
+int PipelineExecutor::getDroppedFrames()
+{
+    return mDroppedFrames;
+}
+
+void PipelineExecutor::runStage(int stage, const std::atomic<bool> &stopFlag)
+{
+    SPSCQueue<VisionFrame *> &input{*mQueues.at(stage)};
+    SPSCQueue<VisionFrame *> &output{*mQueues.at((stage + 1) % mQueues.size())};
+
+    while (!stopFlag)
+    {
+        VisionFrame *frame;
+        if (!input.popWait(frame, std::chrono::milliseconds{100}))
+            continue;
+
+        if (stage == 0)
+        {
+            while (!stopFlag && !mStages.front()(*frame))
+            {
+            }
+
+            frame->stale = stopFlag;
+        }
+        else if (!frame->stale)
+        {
+            // A newer frame is already waiting, so skip straight to it rather than fall further behind
+            if (!input.empty())
+            {
+                frame->stale = true;
+                ++mDroppedFrames;
+            }
+            else if (!mStages.at(stage)(*frame))
+            {
+                frame->stale = true;
+            }
+        }
+
+        // Capacity matches the pool size, so this never fails
+        output.push(frame);
+    }
+}
+
+PipelineExecutor::StageThread::StageThread(PipelineExecutor &executor, int stage)
+    : mExecutor{executor}, mStage{stage}
+{
+    start();
+}
+
+PipelineExecutor::StageThread::~StageThread()
+{
+    stop();
+}
+
+void PipelineExecutor::StageThread::run()
+{
+    mExecutor.runStage(mStage, stopFlag);
+}
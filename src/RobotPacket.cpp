@@ -0,0 +1,85 @@
+#include "RobotPacket.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
+
+namespace
+{
+// Byte by byte, so the layout doesn't depend on the host's endianness or struct padding
+template <typename T>
+uint8_t *put(uint8_t *buffer, T value)
+{
+    typename std::conditional<sizeof(T) == 8, uint64_t, uint32_t>::type bits;
+    std::memcpy(&bits, &value, sizeof(T));
+    for (size_t byte{0}; byte < sizeof(T); ++byte)
+        buffer[byte] = static_cast<uint8_t>(bits >> (8 * byte));
+    return buffer + sizeof(T);
+}
+
+template <typename T>
+const uint8_t *get(const uint8_t *buffer, T &value)
+{
+    typename std::conditional<sizeof(T) == 8, uint64_t, uint32_t>::type bits{0};
+    for (size_t byte{0}; byte < sizeof(T); ++byte)
+        bits |= static_cast<decltype(bits)>(buffer[byte]) << (8 * byte);
+    std::memcpy(&value, &bits, sizeof(T));
+    return buffer + sizeof(T);
+}
+} // namespace
+
+size_t RobotPacket::write(uint8_t *buffer) const
+{
+    int written{std::min(std::max(targetCount, 0), maxTargets)};
+
+    uint8_t *position{buffer};
+    *position++ = currentVersion;
+    *position++ = flags;
+    *position++ = static_cast<uint8_t>(std::min(std::max(pairCount, 0), 255));
+    *position++ = static_cast<uint8_t>(written);
+    position = put(position, frameNumber);
+    position = put(position, captureTime);
+    position = put(position, processedTime);
+    position = put(position, filteredAngle);
+    position = put(position, filteredRate);
+    position = put(position, filteredConfidence);
+
+    for (int t{0}; t < written; ++t)
+    {
+        position = put(position, targets[t].horizontalAngleError);
+        position = put(position, targets[t].area);
+        position = put(position, targets[t].width);
+        position = put(position, targets[t].confidence);
+    }
+
+    return position - buffer;
+}
+
+bool RobotPacket::read(const uint8_t *buffer, size_t size)
+{
+    if (size < headerSize || buffer[0] != currentVersion || buffer[3] > maxTargets || size < headerSize + buffer[3] * targetSize)
+        return false;
+
+    RobotPacket packet;
+    const uint8_t *position{buffer + 1};
+    packet.flags = *position++;
+    packet.pairCount = *position++;
+    packet.targetCount = *position++;
+    position = get(position, packet.frameNumber);
+    position = get(position, packet.captureTime);
+    position = get(position, packet.processedTime);
+    position = get(position, packet.filteredAngle);
+    position = get(position, packet.filteredRate);
+    position = get(position, packet.filteredConfidence);
+
+    for (int t{0}; t < packet.targetCount; ++t)
+    {
+        position = get(position, packet.targets[t].horizontalAngleError);
+        position = get(position, packet.targets[t].area);
+        position = get(position, packet.targets[t].width);
+        position = get(position, packet.targets[t].confidence);
+    }
+
+    *this = packet;
+    return true;
+}
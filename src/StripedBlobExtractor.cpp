@@ -0,0 +1,190 @@
+#include "StripedBlobExtractor.hpp"
+
+#include <algorithm>
+#include <climits>
+
+void StripedBlobExtractor::extract(const cv::Mat &mask, cv::Point offset, int stripes, WorkStealingPool &pool)
+{
+    CV_Assert(mask.type() == CV_8UC1);
+
+    mStripeCount = std::max(1, std::min(stripes, mask.rows));
+    if (static_cast<int>(mStripes.size()) < mStripeCount)
+        mStripes.resize(mStripeCount);
+
+    auto getStripeTop = [this, &mask](int stripe) {
+        return stripe * mask.rows / mStripeCount;
+    };
+
+    pool.run(mStripeCount, [this, &mask, offset, &getStripeTop](int stripe) {
+        int top{getStripeTop(stripe)};
+        mStripes[stripe].extract(mask.rowRange(top, getStripeTop(stripe + 1)), offset + cv::Point{0, top});
+    });
+
+    mFirstPiece.resize(mStripeCount + 1);
+    mFirstPiece[0] = 0;
+    for (int stripe{0}; stripe < mStripeCount; ++stripe)
+        mFirstPiece[stripe + 1] = mFirstPiece[stripe] + mStripes[stripe].getStats().size();
+
+    int pieces{mFirstPiece[mStripeCount]};
+    mPieceStripe.resize(pieces);
+    mParents.resize(pieces);
+    for (int stripe{0}; stripe < mStripeCount; ++stripe)
+    {
+        for (int piece{mFirstPiece[stripe]}; piece < mFirstPiece[stripe + 1]; ++piece)
+        {
+            mPieceStripe[piece] = stripe;
+            mParents[piece] = piece;
+        }
+    }
+
+    for (int stripe{1}; stripe < mStripeCount; ++stripe)
+        stitch(stripe, offset.y + getStripeTop(stripe));
+
+    // Numbers the blobs in order of their first piece, which is the order BlobExtractor would have found them in
+    int blobs{0};
+    mBlobOfPiece.assign(pieces, -1);
+    for (int piece{0}; piece < pieces; ++piece)
+    {
+        int root{findRoot(piece)};
+        if (mBlobOfPiece[root] == -1)
+            mBlobOfPiece[root] = blobs++;
+        mBlobOfPiece[piece] = mBlobOfPiece[root];
+    }
+
+    // Groups the pieces by blob, counting them first and then placing each
+    mFirstPieceOfBlob.assign(blobs + 1, 0);
+    for (int piece{0}; piece < pieces; ++piece)
+        ++mFirstPieceOfBlob[mBlobOfPiece[piece] + 1];
+    for (int blob{0}; blob < blobs; ++blob)
+        mFirstPieceOfBlob[blob + 1] += mFirstPieceOfBlob[blob];
+
+    // mParents is done with, so it doubles as each blob's next free slot
+    std::vector<int> &nextSlot{mParents};
+    std::copy(mFirstPieceOfBlob.begin(), mFirstPieceOfBlob.end() - 1, nextSlot.begin());
+    mPieces.resize(pieces);
+    for (int piece{0}; piece < pieces; ++piece)
+        mPieces[nextSlot[mBlobOfPiece[piece]]++] = piece;
+
+    // Every statistic is a minimum, maximum or sum over pixels, so the pieces' combine exactly
+    mStats.resize(blobs);
+    for (int piece{0}; piece < pieces; ++piece)
+    {
+        int blob{mBlobOfPiece[piece]};
+        int stripe{mPieceStripe[piece]};
+        int local{piece - mFirstPiece[stripe]};
+        const BlobStats &stats{mStripes[stripe].getStats()};
+
+        mStats.area[blob] += stats.area[local];
+        mStats.left[blob] = std::min(mStats.left[blob], stats.left[local]);
+        mStats.top[blob] = std::min(mStats.top[blob], stats.top[local]);
+        mStats.right[blob] = std::max(mStats.right[blob], stats.right[local]);
+        mStats.bottom[blob] = std::max(mStats.bottom[blob], stats.bottom[local]);
+        mStats.m10[blob] += stats.m10[local];
+        mStats.m01[blob] += stats.m01[local];
+        mStats.m20[blob] += stats.m20[local];
+        mStats.m11[blob] += stats.m11[local];
+        mStats.m02[blob] += stats.m02[local];
+    }
+}
+
+const BlobStats &StripedBlobExtractor::getStats() const
+{
+    return mStats;
+}
+
+void StripedBlobExtractor::appendOutline(int blob, std::vector<cv::Point> &outline)
+{
+    int first{mFirstPieceOfBlob.at(blob)}, last{mFirstPieceOfBlob.at(blob + 1)};
+    if (last - first == 1)
+    {
+        int piece{mPieces[first]};
+        int stripe{mPieceStripe[piece]};
+        mStripes[stripe].appendOutline(piece - mFirstPiece[stripe], outline);
+        return;
+    }
+
+    // Several pieces can share a row, e.g. the arms of a U joined further down, so each row's ends are found first
+    int top{mStats.top[blob]};
+    int rows{mStats.bottom[blob] - top + 1};
+    mRowLeft.assign(rows, INT_MAX);
+    mRowRight.assign(rows, INT_MIN);
+    for (int p{first}; p < last; ++p)
+    {
+        int piece{mPieces[p]};
+        int stripe{mPieceStripe[piece]};
+        int local{piece - mFirstPiece[stripe]};
+        const BlobStats &stats{mStripes[stripe].getStats()};
+        const std::vector<Run> &runs{mStripes[stripe].getRuns()};
+
+        for (int run{stats.firstRun[local]}; run < stats.firstRun[local] + stats.runCount[local]; ++run)
+        {
+            int row{runs[run].y - top};
+            mRowLeft[row] = std::min(mRowLeft[row], runs[run].start);
+            mRowRight[row] = std::max(mRowRight[row], runs[run].end);
+        }
+    }
+
+    // A blob is connected, so every row from its top to its bottom has pixels
+    for (int row{0}; row < rows; ++row)
+        outline.push_back(cv::Point{mRowLeft[row], top + row});
+    for (int row{rows - 1}; row >= 0; --row)
+        outline.push_back(cv::Point{mRowRight[row], top + row});
+}
+
+int StripedBlobExtractor::findRoot(int piece)
+{
+    // Path halving keeps the trees flat without recursion
+    while (mParents[piece] != piece)
+    {
+        mParents[piece] = mParents[mParents[piece]];
+        piece = mParents[piece];
+    }
+    return piece;
+}
+
+void StripedBlobExtractor::unite(int a, int b)
+{
+    int rootA{findRoot(a)}, rootB{findRoot(b)};
+
+    // The earlier piece stays the root
+    if (rootA < rootB)
+        mParents[rootB] = rootA;
+    else if (rootB < rootA)
+        mParents[rootA] = rootB;
+}
+
+void StripedBlobExtractor::stitch(int stripe, int seamY)
+{
+    auto byStart = [](const Run &a, const Run &b) {
+        return a.start < b.start;
+    };
+
+    // Runs are grouped by blob, so the seam rows' runs are picked out and put back in x order
+    mAbove.clear();
+    for (const Run &run : mStripes[stripe - 1].getRuns())
+    {
+        if (run.y == seamY - 1)
+            mAbove.push_back(run);
+    }
+    mBelow.clear();
+    for (const Run &run : mStripes[stripe].getRuns())
+    {
+        if (run.y == seamY)
+            mBelow.push_back(run);
+    }
+    if (mAbove.empty() || mBelow.empty())
+        return;
+
+    std::sort(mAbove.begin(), mAbove.end(), byStart);
+    std::sort(mBelow.begin(), mBelow.end(), byStart);
+
+    // The same sweep BlobExtractor joins consecutive rows with, diagonal neighbours included
+    size_t above{0};
+    for (const Run &run : mBelow)
+    {
+        while (above < mAbove.size() && mAbove[above].end < run.start - 1)
+            ++above;
+        for (size_t candidate{above}; candidate < mAbove.size() && mAbove[candidate].start <= run.end + 1; ++candidate)
+            unite(mFirstPiece[stripe - 1] + mAbove[candidate].blob, mFirstPiece[stripe] + run.blob);
+    }
+}
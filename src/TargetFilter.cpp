@@ -0,0 +1,79 @@
+#include "TargetFilter.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+double secondsBetween(std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end)
+{
+    return std::chrono::duration<double>{end - start}.count();
+}
+} // namespace
+
+void TargetFilter::update(const VisionFrame &frame, const VisionConfig &config)
+{
+    std::lock_guard<std::mutex> lock{mMutex};
+
+    mDropout = std::chrono::milliseconds{std::max(config.filterDropout.value, 0)};
+
+    if (mValid && frame.captureTime - mMeasurementTime > mDropout)
+        mValid = false;
+
+    // Frames are processed in order, but one captured before the last measurement would wind the filter backwards
+    if (!frame.foundTarget || frame.targets.empty() || (mValid && frame.captureTime <= mMeasurementTime))
+        return;
+
+    const Target &target{frame.targets.front()};
+    double alpha{std::min(std::max(config.filterAlpha.value / 100.0, 0.0), 1.0)};
+    double beta{std::min(std::max(config.filterBeta.value / 100.0, 0.0), 1.0)};
+
+    double elapsed{mValid ? secondsBetween(mMeasurementTime, frame.captureTime) : 0};
+    double predicted{mAngle + mRate * elapsed};
+    double residual{target.horizontalAngleError - predicted};
+
+    if (!mValid || std::abs(residual) > maxJump)
+    {
+        // Starts over rather than dragging the estimate across from a different target
+        mAngle = target.horizontalAngleError;
+        mRate = 0;
+        mConfidence = target.confidence * alpha;
+    }
+    else
+    {
+        mAngle = predicted + alpha * residual;
+        // Frames from the same instant say nothing about speed
+        if (elapsed > 0.001)
+            mRate += beta * residual / elapsed;
+        mConfidence += alpha * (target.confidence - mConfidence);
+    }
+
+    mValid = true;
+    mMeasurementTime = frame.captureTime;
+}
+
+TargetEstimate TargetFilter::predict(std::chrono::steady_clock::time_point time) const
+{
+    std::lock_guard<std::mutex> lock{mMutex};
+
+    TargetEstimate estimate;
+    double elapsed{secondsBetween(mMeasurementTime, time)};
+    double dropout{std::chrono::duration<double>{mDropout}.count()};
+    if (!mValid || elapsed > dropout)
+        return estimate;
+
+    estimate.valid = true;
+    estimate.horizontalAngleError = mAngle + mRate * std::max(elapsed, 0.0);
+    estimate.angleRate = mRate;
+
+    // Fades linearly to nothing at the end of the dropout
+    estimate.confidence = dropout > 0 ? mConfidence * (1 - std::max(elapsed, 0.0) / dropout) : mConfidence;
+
+    return estimate;
+}
+
+void TargetFilter::reset()
+{
+    std::lock_guard<std::mutex> lock{mMutex};
+    mValid = false;
+}
@@ -0,0 +1,111 @@
+#include "TargetPairer.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+// Strips are longer than they are wide, whichever way minAreaRect measured them
+double getLength(const Contour &contour)
+{
+    return std::max(contour.rotatedBoundingBox.size.width, contour.rotatedBoundingBox.size.height);
+}
+
+// 1 within [fullLow, fullHigh], falling linearly to 0 at zeroLow and zeroHigh
+double getTrapezoid(double value, double zeroLow, double fullLow, double fullHigh, double zeroHigh)
+{
+    if (value <= zeroLow || value >= zeroHigh)
+        return 0;
+    if (value < fullLow)
+        return (value - zeroLow) / (fullLow - zeroLow);
+    if (value > fullHigh)
+        return (zeroHigh - value) / (zeroHigh - fullHigh);
+    return 1;
+}
+} // namespace
+
+const std::vector<ContourPair> &TargetPairer::pair(const std::vector<Contour> &contours, int frameWidth)
+{
+    mPairs.clear();
+
+    mOrder.resize(contours.size());
+    for (size_t c{0}; c < contours.size(); ++c)
+        mOrder[c] = c;
+    std::sort(mOrder.begin(), mOrder.end(), [&contours](int a, int b) {
+        return contours[a].rotatedBoundingBox.center.x < contours[b].rotatedBoundingBox.center.x;
+    });
+
+    // Strips leaning right, in x order, from the first the sweep is still within reach of
+    // A strip leaves the front once the sweep is further right of it than any partner could be. Those behind a longer
+    // strip wait for it to leave too, but score nothing meanwhile since getScore() is 0 past maxSpacing
+    mOpen.clear();
+    size_t firstOpen{0};
+    mCandidates.clear();
+    for (int contour : mOrder)
+    {
+        const Contour &current{contours[contour]};
+        double x{current.rotatedBoundingBox.center.x};
+        while (firstOpen < mOpen.size() &&
+               x - contours[mOpen[firstOpen]].rotatedBoundingBox.center.x > maxSpacing * getLength(contours[mOpen[firstOpen]]))
+            ++firstOpen;
+
+        if (current.angle > 0)
+        {
+            mOpen.push_back(contour);
+        }
+        else if (current.angle < 0)
+        {
+            for (size_t o{firstOpen}; o < mOpen.size(); ++o)
+            {
+                double score{getScore(contours[mOpen[o]], current)};
+                if (score >= minScore)
+                    mCandidates.push_back(ContourPair{mOpen[o], contour, score, (contours[mOpen[o]].rotatedBoundingBox.center.x + x) / 2});
+            }
+        }
+    }
+
+    // Best first, so a stray reflection between a target's halves can't take one of them from the better pair
+    std::sort(mCandidates.begin(), mCandidates.end(), [](const ContourPair &a, const ContourPair &b) {
+        if (a.score != b.score)
+            return a.score > b.score;
+        return a.left < b.left || (a.left == b.left && a.right < b.right);
+    });
+
+    mPaired.assign(contours.size(), false);
+    for (const ContourPair &candidate : mCandidates)
+    {
+        if (mPaired[candidate.left] || mPaired[candidate.right])
+            continue;
+
+        mPaired[candidate.left] = true;
+        mPaired[candidate.right] = true;
+        mPairs.push_back(candidate);
+    }
+
+    double middle{frameWidth / 2.0};
+    std::sort(mPairs.begin(), mPairs.end(), [middle](const ContourPair &a, const ContourPair &b) {
+        return std::abs(a.centerX - middle) < std::abs(b.centerX - middle);
+    });
+
+    return mPairs;
+}
+
+double TargetPairer::getScore(const Contour &left, const Contour &right)
+{
+    double leftLength{getLength(left)}, rightLength{getLength(right)};
+    double length{(leftLength + rightLength) / 2};
+    if (length <= 0)
+        return 0;
+
+    double lengthSimilarity{std::min(leftLength, rightLength) / std::max(leftLength, rightLength)};
+
+    // 90 degrees apart from mirror images is as unlike as they get
+    double symmetry{std::max(0.0, 1 - std::abs(left.angle + right.angle) / 90)};
+
+    double level{std::max(0.0, 1 - std::abs(left.rotatedBoundingBox.center.y - right.rotatedBoundingBox.center.y) / length)};
+
+    // A target's strip centers are a little over two strip lengths apart, less when seen from an angle
+    double spacing{getTrapezoid((right.rotatedBoundingBox.center.x - left.rotatedBoundingBox.center.x) / length, 0.25, 0.75, 3.5, maxSpacing)};
+
+    return lengthSimilarity * symmetry * level * spacing;
+}
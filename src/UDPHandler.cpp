@@ -1,6 +1,7 @@
 #include "UDPHandler.hpp"
 
-UDPHandler::UDPHandler(int port) : mSocket{mIoService, boost::asio::ip::udp::endpoint(boost::asio::ip::udp::v4(), port)}
+UDPHandler::UDPHandler(int port, bool queueReceived)
+    : mSocket{mIoService, boost::asio::ip::udp::endpoint(boost::asio::ip::udp::v4(), port)}, mQueueReceived{queueReceived}
 {
     startReceiving();
     start();
@@ -43,6 +44,14 @@ void UDPHandler::sendTo(std::string message, boost::asio::ip::udp::endpoint send
                                       boost::asio::placeholders::bytes_transferred));
 }
 
+bool UDPHandler::sendTo(const uint8_t *data, size_t size, const boost::asio::ip::udp::endpoint &sendEndpoint)
+{
+    // A datagram either fits in the socket buffer right away or is dropped, so sending synchronously doesn't stall
+    boost::system::error_code error;
+    mSocket.send_to(boost::asio::buffer(data, size), sendEndpoint, 0, error);
+    return !error;
+}
+
 void UDPHandler::reply(std::string message)
 {
     sendTo(message, mRemoteEndpoint);
@@ -53,7 +62,13 @@ void UDPHandler::handleReceive(const boost::system::error_code &error,
 {
     if (!error || error == boost::asio::error::message_size)
     {
-        mReceivedMessage = std::string{mReceiveBuffer.data()}.substr(0, bytesTransferred);
+        if (mQueueReceived)
+        {
+            mDatagram.message.assign(mReceiveBuffer.data(), bytesTransferred);
+            mDatagram.sender = mRemoteEndpoint;
+            if (!mReceived.push(mDatagram))
+                std::cout << "Dropped UDP message, too many are waiting to be handled\n";
+        }
 
         reply("received");
     }
@@ -66,12 +81,7 @@ void UDPHandler::handleSend(boost::shared_ptr<std::string> /*message*/,
 {
 }
 
-std::string UDPHandler::getMessage()
-{
-    return mReceivedMessage;
-}
-
-void UDPHandler::clearMessage()
+bool UDPHandler::receive(Datagram &datagram, std::chrono::milliseconds timeout)
 {
-    mReceivedMessage.clear();
+    return mReceived.popWait(datagram, timeout);
 }
@@ -0,0 +1,424 @@
+#include "VisionPipeline.hpp"
+
+#include <algorithm>
+#include <thread>
+
+#include "HSVThreshold.hpp"
+
+VisionPipeline::VisionPipeline(const ConfigSnapshot<VisionConfig> &visionConfig, const ConfigSnapshot<RaspicamConfig> &raspicamConfig)
+    : mVisionConfig{visionConfig}, mRaspicamConfig{raspicamConfig}
+{
+}
+
+namespace
+{
+// Pads rect by horizontal and vertical pixels on each side
+cv::Rect expand(const cv::Rect &rect, int horizontal, int vertical)
+{
+    return cv::Rect{rect.x - horizontal, rect.y - vertical, rect.width + 2 * horizontal, rect.height + 2 * vertical};
+}
+
+// The first row of stripe out of stripes in rows rows, so that stripe + 1 gives where it ends
+inline int getStripeTop(int stripe, int stripes, int rows)
+{
+    return stripe * rows / stripes;
+}
+
+// Outlines the blobs extractor found that are worth validating, recording where each outline is in points
+// The outline joins the ends of each row through the pixel centres, so it never encloses more than the box between
+// those centres, and at most a row and a column's worth of pixels less than the blob has. A hollow or concave blob
+// encloses more than its pixels, so only the box bounds it from above. These bounds only reject blobs that could
+// never pass the real area check and save tracing an outline for the rest
+template <typename Extractor>
+void appendOutlines(Extractor &extractor, const VisionConfig &config, std::vector<cv::Point> &points, std::vector<cv::Range> &outlines)
+{
+    const BlobStats &blobs{extractor.getStats()};
+    for (int blob{0}; blob < blobs.size(); ++blob)
+    {
+        int width{blobs.right[blob] - blobs.left[blob] + 1}, height{blobs.bottom[blob] - blobs.top[blob] + 1};
+        if ((width - 1) * (height - 1) < config.minArea.value || blobs.area[blob] - width - height > config.maxArea.value)
+            continue;
+
+        int firstPoint{static_cast<int>(points.size())};
+        extractor.appendOutline(blob, points);
+        outlines.push_back(cv::Range{firstPoint, static_cast<int>(points.size())});
+    }
+}
+} // namespace
+
+void VisionPipeline::segment(VisionFrame &frame)
+{
+    threshold(frame);
+    removeNoise(frame);
+}
+
+void VisionPipeline::findTargets(VisionFrame &frame)
+{
+    findContours(frame);
+    pairContours(frame);
+}
+
+void VisionPipeline::threshold(VisionFrame &frame)
+{
+    StageTimer timer{frame, Metrics::segment};
+
+    // Every later stage of this frame uses the same settings, even if new ones are published meanwhile
+    frame.visionConfig = mVisionConfig.get();
+    const VisionConfig &config{*frame.visionConfig};
+
+    frame.roi = getSearchWindow(frame.frame.size());
+
+    HSVThreshold hsvThreshold{config.lowHue.value, config.lowSaturation.value, config.lowValue.value, config.highHue.value, config.highSaturation.value, config.highValue.value};
+    mLookupTable.update(hsvThreshold);
+
+    // The mask is a header over a buffer sized for the whole frame, so a moving window never reallocates
+    frame.maskBuffer.create(frame.frame.size(), CV_8UC1);
+    frame.mask = cv::Mat{frame.roi.size(), CV_8UC1, frame.maskBuffer.data};
+
+    frame.regions.clear();
+    if (config.detectionScale.value <= 1)
+    {
+        frame.regions.push_back(frame.roi);
+        thresholdRegion(frame, frame.roi);
+        return;
+    }
+
+    findCandidateRegions(frame, config.detectionScale.value);
+
+    // Only the candidate regions are thresholded at full resolution, and the rest of the mask is left empty
+    frame.mask.setTo(cv::Scalar::all(0));
+    for (const cv::Rect &region : frame.regions)
+        thresholdRegion(frame, region);
+}
+
+void VisionPipeline::removeNoise(VisionFrame &frame)
+{
+    StageTimer timer{frame, Metrics::morphology};
+
+    for (const cv::Rect &region : frame.regions)
+        openRegion(frame, region);
+}
+
+void VisionPipeline::findContours(VisionFrame &frame)
+{
+    frame.contours.clear();
+    frame.contourPoints.clear();
+    mOutlines.clear();
+
+    const VisionConfig &config{*frame.visionConfig};
+
+    // Labels the blobs straight from the mask, in full-frame coordinates, and outlines the ones worth validating
+    // The outlines all go in the arena before any contour views it, so it's free to reallocate until then
+    {
+        StageTimer timer{frame, Metrics::contours};
+        for (const cv::Rect &region : frame.regions)
+        {
+            cv::Mat regionMask{frame.mask(region - frame.roi.tl())};
+            if (config.stripes.value > 1)
+            {
+                mStripedExtractor.extract(regionMask, region.tl(), config.stripes.value, getPool());
+                appendOutlines(mStripedExtractor, config, frame.contourPoints, mOutlines);
+            }
+            else
+            {
+                mBlobExtractor.extract(regionMask, region.tl());
+                appendOutlines(mBlobExtractor, config, frame.contourPoints, mOutlines);
+            }
+        }
+    }
+
+    StageTimer timer{frame, Metrics::validation};
+    for (const cv::Range &outline : mOutlines)
+    {
+        Contour newContour{frame.contourPoints.data() + outline.start, outline.size()};
+        if (newContour.isValid(config.minArea.value, config.maxArea.value, config.minRotation.value, config.allowableError.value))
+        {
+            frame.contours.push_back(newContour);
+        }
+    }
+}
+
+void VisionPipeline::pairContours(VisionFrame &frame)
+{
+    StageTimer timer{frame, Metrics::pairing};
+
+    frame.foundTarget = false;
+    frame.targets.clear();
+
+    const std::vector<ContourPair> &pairs{mPairer.pair(frame.contours, frame.frame.cols)};
+    if (pairs.empty())
+    {
+        updateTracking(frame);
+        return;
+    }
+
+    // A strip can be in more than one pair, so each one's corners are only refined once
+    // A new calibration applies from the next frame, without restarting the camera
+    std::shared_ptr<const RaspicamConfig> cameraConfig{mRaspicamConfig.get()};
+    if (cameraConfig && cameraConfig != mCameraConfig)
+    {
+        mCameraModel.setConfig(*cameraConfig);
+        mCameraConfig = cameraConfig;
+    }
+    mCameraModel.setFrameSize(frame.frame.size());
+    mCorners.resize(frame.contours.size());
+    mCornersRefined.assign(frame.contours.size(), false);
+    for (const ContourPair &pair : pairs)
+    {
+        for (int contour : {pair.left, pair.right})
+        {
+            if (!mCornersRefined[contour])
+            {
+                refineCorners(frame.frame, frame.contours[contour], mCorners[contour]);
+                mCornersRefined[contour] = true;
+            }
+        }
+    }
+
+    // Every pair is a candidate for the robot, nearest the middle first
+    for (const ContourPair &pair : pairs)
+        frame.targets.push_back(makeTarget(frame.contours[pair.left], frame.contours[pair.right], mCorners[pair.left], mCorners[pair.right], pair.score));
+
+    // Contours are small views, so copying the winning pair out is cheap
+    frame.closestPair = std::array<Contour, 2>{frame.contours[pairs.front().left], frame.contours[pairs.front().right]};
+
+    frame.centerX = frame.targets.front().centerX;
+    frame.centerY = frame.targets.front().centerY;
+    frame.horizontalAngleError = frame.targets.front().horizontalAngleError;
+    frame.foundTarget = true;
+
+    updateTracking(frame);
+}
+
+Target VisionPipeline::makeTarget(const Contour &left, const Contour &right, const std::array<cv::Point2f, 4> &leftCorners,
+                                  const std::array<cv::Point2f, 4> &rightCorners, double score)
+{
+    Target target;
+
+    mTargetPoints.assign(leftCorners.begin(), leftCorners.end());
+    mTargetPoints.insert(mTargetPoints.end(), rightCorners.begin(), rightCorners.end());
+
+    // The middle of the target is the mean of the strips' corners, both in the frame and once they're undistorted
+    cv::Point2f center{}, ray{};
+    mCameraModel.toRays(mTargetPoints, mTargetRays);
+    for (size_t p{0}; p < mTargetPoints.size(); ++p)
+    {
+        center += mTargetPoints[p];
+        ray += mTargetRays[p];
+    }
+    center /= static_cast<float>(mTargetPoints.size());
+    ray /= static_cast<float>(mTargetRays.size());
+
+    target.centerX = center.x;
+    target.centerY = center.y;
+    target.horizontalAngleError = CameraModel::getHorizontalAngle(ray);
+    target.area = left.area + right.area;
+    target.width = (left.boundingBox | right.boundingBox).width;
+    target.confidence = score;
+
+    return target;
+}
+
+void VisionPipeline::refineCorners(const cv::Mat &image, const Contour &contour, std::array<cv::Point2f, 4> &corners)
+{
+    std::copy(contour.rotatedBoundingBoxPoints, contour.rotatedBoundingBoxPoints + 4, corners.begin());
+
+    // The outline runs through the centres of the strip's edge pixels, so its corners are about half a pixel in from
+    // the real ones. The window mustn't be so big it takes in the strip's other corners
+    cv::Size2f size{contour.rotatedBoundingBox.size};
+    int radius{std::min(maxCornerRadius, static_cast<int>(std::min(size.width, size.height) / 4))};
+    if (radius < 1)
+        return;
+
+    int padding{radius + 2};
+    cv::Rect window{cv::Rect{contour.boundingBox.x - padding, contour.boundingBox.y - padding, contour.boundingBox.width + 2 * padding,
+                             contour.boundingBox.height + 2 * padding} &
+                    cv::Rect{0, 0, image.cols, image.rows}};
+
+    // A header over a buffer sized for the whole frame, so strips of any size never reallocate
+    mGrayBuffer.create(image.size(), CV_8UC1);
+    cv::Mat gray{window.size(), CV_8UC1, mGrayBuffer.data};
+    cv::cvtColor(image(window), gray, cv::COLOR_BGR2GRAY);
+
+    std::array<cv::Point2f, 4> refined;
+    for (int c{0}; c < 4; ++c)
+        refined[c] = corners[c] - cv::Point2f{static_cast<float>(window.x), static_cast<float>(window.y)};
+    cv::Mat refinedMat{4, 1, CV_32FC2, refined.data()};
+    cv::cornerSubPix(gray, refinedMat, cv::Size{radius, radius}, cv::Size{-1, -1},
+                     cv::TermCriteria{cv::TermCriteria::COUNT + cv::TermCriteria::EPS, 10, 0.01});
+
+    // A corner that wandered off is more likely to have found something else than the strip's corner
+    for (int c{0}; c < 4; ++c)
+    {
+        cv::Point2f moved{refined[c] + cv::Point2f{static_cast<float>(window.x), static_cast<float>(window.y)}};
+        if (cv::norm(moved - corners[c]) <= radius)
+            corners[c] = moved;
+    }
+}
+
+void VisionPipeline::process(VisionFrame &frame)
+{
+    segment(frame);
+    findTargets(frame);
+}
+
+cv::Rect VisionPipeline::getSearchWindow(const cv::Size &frameSize)
+{
+    cv::Rect wholeFrame{cv::Point{0, 0}, frameSize};
+
+    std::lock_guard<std::mutex> lock{mTrackingMutex};
+    if (!mTracking)
+        return wholeFrame;
+
+    cv::Rect window{mTrackingWindow & wholeFrame};
+    return window.empty() ? wholeFrame : window;
+}
+
+WorkStealingPool &VisionPipeline::getPool()
+{
+    std::call_once(mPoolStarted, [this] {
+        mPool.reset(new WorkStealingPool{std::max(1, static_cast<int>(std::thread::hardware_concurrency())) - 1});
+    });
+    return *mPool;
+}
+
+void VisionPipeline::thresholdRegion(VisionFrame &frame, const cv::Rect &region)
+{
+    int stripes{std::min(frame.visionConfig->stripes.value, region.height)};
+    if (stripes <= 1)
+    {
+        cv::Mat regionMask{frame.mask(region - frame.roi.tl())};
+        mLookupTable.apply(frame.frame(region), regionMask);
+        return;
+    }
+
+    // Each stripe only writes its own rows of the mask
+    getPool().run(stripes, [this, &frame, &region, stripes](int stripe) {
+        int top{getStripeTop(stripe, stripes, region.height)};
+        cv::Rect stripeRect{region.x, region.y + top, region.width, getStripeTop(stripe + 1, stripes, region.height) - top};
+        cv::Mat stripeMask{frame.mask(stripeRect - frame.roi.tl())};
+        mLookupTable.apply(frame.frame(stripeRect), stripeMask);
+    });
+}
+
+void VisionPipeline::openRegion(VisionFrame &frame, const cv::Rect &region)
+{
+    int passes{frame.visionConfig->erosionDilationPasses.value};
+    int stripes{std::min(frame.visionConfig->stripes.value, region.height)};
+    cv::Mat regionMask{frame.mask(region - frame.roi.tl())};
+    if (stripes <= 1 || passes <= 0)
+    {
+        mOpening.apply(regionMask, passes);
+        return;
+    }
+
+    if (static_cast<int>(mStripeMasks.size()) < stripes)
+    {
+        mStripeMasks.resize(stripes);
+        mStripeOpenings.resize(stripes);
+    }
+
+    // A row of the opened mask depends on the rows up to twice the passes away, so each stripe is opened along with
+    // that many of its neighbours' rows, and only its own rows are kept
+    // Every stripe copies out before any writes back, since they'd otherwise read rows their neighbours are changing
+    int halo{2 * passes};
+    getPool().run(stripes, [this, &regionMask, stripes, halo](int stripe) {
+        int top{std::max(0, getStripeTop(stripe, stripes, regionMask.rows) - halo)};
+        int bottom{std::min(regionMask.rows, getStripeTop(stripe + 1, stripes, regionMask.rows) + halo)};
+        regionMask.rowRange(top, bottom).copyTo(mStripeMasks[stripe]);
+    });
+
+    getPool().run(stripes, [this, &regionMask, stripes, halo, passes](int stripe) {
+        int top{getStripeTop(stripe, stripes, regionMask.rows)};
+        int bottom{getStripeTop(stripe + 1, stripes, regionMask.rows)};
+        int haloTop{std::max(0, top - halo)};
+
+        mStripeOpenings[stripe].apply(mStripeMasks[stripe], passes);
+        cv::Mat ownRows{regionMask.rowRange(top, bottom)};
+        mStripeMasks[stripe].rowRange(top - haloTop, bottom - haloTop).copyTo(ownRows);
+    });
+}
+
+void VisionPipeline::findCandidateRegions(VisionFrame &frame, int scale)
+{
+    const VisionConfig &config{*frame.visionConfig};
+
+    // Whole coarse pixels only, so each one stands for exactly scale by scale pixels of the frame
+    cv::Size coarseSize{frame.roi.width / scale, frame.roi.height / scale};
+    if (coarseSize.area() == 0)
+        return;
+
+    // Nearest neighbour only reads the pixels it keeps
+    cv::resize(frame.frame(cv::Rect{frame.roi.tl(), coarseSize * scale}), mCoarseFrame, coarseSize, 0, 0, cv::INTER_NEAREST);
+    mLookupTable.apply(mCoarseFrame, mCoarseMask);
+
+    // Not opened, since a strip far enough away to be thin could be eroded away entirely at this size
+    // Specks of noise are mostly too small to pass the area bound, and the opening at full resolution clears the rest
+    mCoarseExtractor.extract(mCoarseMask);
+    const BlobStats &blobs{mCoarseExtractor.getStats()};
+
+    // Sampling can lose or gain a good share of a small blob's pixels, so the area bounds are halved and doubled, and
+    // each region is padded enough to hold the whole blob at full resolution before the opening shrinks it
+    int padding{scale + config.erosionDilationPasses.value};
+    for (int blob{0}; blob < blobs.size(); ++blob)
+    {
+        int area{blobs.area[blob] * scale * scale};
+        if (area * 2 < config.minArea.value || area > config.maxArea.value * 2)
+            continue;
+
+        cv::Rect region{frame.roi.x + blobs.left[blob] * scale, frame.roi.y + blobs.top[blob] * scale,
+                        (blobs.right[blob] - blobs.left[blob] + 1) * scale, (blobs.bottom[blob] - blobs.top[blob] + 1) * scale};
+        frame.regions.push_back(expand(region, padding, padding) & frame.roi);
+    }
+
+    // A blob split between two regions would be found as two pieces, so regions that touch are merged until none do
+    bool merged{true};
+    while (merged)
+    {
+        merged = false;
+        for (size_t a{0}; a < frame.regions.size(); ++a)
+        {
+            for (size_t b{a + 1}; b < frame.regions.size();)
+            {
+                if ((expand(frame.regions[a], 1, 1) & frame.regions[b]).empty())
+                {
+                    ++b;
+                    continue;
+                }
+
+                frame.regions[a] |= frame.regions[b];
+                frame.regions.erase(frame.regions.begin() + b);
+                merged = true;
+            }
+        }
+    }
+}
+
+void VisionPipeline::updateTracking(const VisionFrame &frame)
+{
+    std::lock_guard<std::mutex> lock{mTrackingMutex};
+
+    // 0 turns tracking off
+    if (frame.visionConfig->trackingMisses.value <= 0)
+    {
+        mTracking = false;
+        return;
+    }
+
+    if (frame.foundTarget)
+    {
+        // Leaves room for the target to move by its own size before the next frame
+        cv::Rect target{frame.closestPair.at(0).boundingBox | frame.closestPair.at(1).boundingBox};
+        mTrackingWindow = expand(target, target.width, target.height);
+        mTracking = true;
+        mTrackingMisses = 0;
+    }
+    else if (mTracking)
+    {
+        // Widens the search on every miss, and gives up on the window entirely after too many
+        if (++mTrackingMisses > frame.visionConfig->trackingMisses.value)
+            mTracking = false;
+        else
+            mTrackingWindow = expand(mTrackingWindow, mTrackingWindow.width / 4, mTrackingWindow.height / 4);
+    }
+}
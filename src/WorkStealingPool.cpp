@@ -0,0 +1,166 @@
+#include "WorkStealingPool.hpp"
+
+WorkStealingPool::WorkStealingPool(int threads)
+{
+    for (int queue{0}; queue < threads; ++queue)
+        mQueues.push_back(std::unique_ptr<Queue>{new Queue});
+
+    // Only once every queue exists, since workers steal from all of them
+    for (int queue{0}; queue < threads; ++queue)
+        mWorkers.push_back(std::unique_ptr<Worker>{new Worker{*this, queue}});
+}
+
+WorkStealingPool::~WorkStealingPool()
+{
+    {
+        std::lock_guard<std::mutex> lock{mMutex};
+        mStopping = true;
+    }
+    mWake.notify_all();
+
+    // Joins each worker
+    mWorkers.clear();
+}
+
+void WorkStealingPool::run(int count, const std::function<void(int)> &task)
+{
+    if (mQueues.empty())
+    {
+        for (int index{0}; index < count; ++index)
+            task(index);
+        return;
+    }
+
+    Job job;
+    job.task = &task;
+    job.remaining = count;
+
+    // Deals the tasks out across the workers' queues, and runs any that don't fit straight away
+    int queues{static_cast<int>(mQueues.size())};
+    int first{mNextQueue.fetch_add(1) % queues};
+    int queued{0};
+    for (int index{0}; index < count; ++index)
+    {
+        if (mQueues[(first + index) % queues]->push(Task{&job, index}))
+            ++queued;
+        else
+            execute(Task{&job, index});
+    }
+
+    {
+        std::lock_guard<std::mutex> lock{mMutex};
+        mQueued += queued;
+    }
+    mWake.notify_all();
+
+    // Helps with whatever's queued rather than just waiting, which may be another job's tasks
+    Task stolen;
+    while (job.remaining > 0 && take(-1, stolen))
+        execute(stolen);
+
+    // The last few tasks may still be running on workers
+    std::unique_lock<std::mutex> lock{mMutex};
+    mFinished.wait(lock, [&job] { return job.remaining == 0; });
+}
+
+bool WorkStealingPool::take(int queue, Task &task)
+{
+    if (queue >= 0 && mQueues[queue]->popNewest(task))
+    {
+        --mQueued;
+        return true;
+    }
+
+    int queues{static_cast<int>(mQueues.size())};
+    for (int offset{1}; offset <= queues; ++offset)
+    {
+        int victim{(queue + offset + queues) % queues};
+        if (victim != queue && mQueues[victim]->popOldest(task))
+        {
+            --mQueued;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void WorkStealingPool::execute(const Task &task)
+{
+    (*task.job->task)(task.index);
+
+    if (--task.job->remaining == 0)
+    {
+        // Taking the lock means the job's thread is either already waiting, or will see it finished before it waits
+        std::lock_guard<std::mutex> lock{mMutex};
+        mFinished.notify_all();
+    }
+}
+
+void WorkStealingPool::work(int queue)
+{
+    while (true)
+    {
+        Task task;
+        if (take(queue, task))
+        {
+            execute(task);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock{mMutex};
+        mWake.wait(lock, [this] { return mStopping || mQueued > 0; });
+        if (mStopping)
+            return;
+    }
+}
+
+bool WorkStealingPool::Queue::push(const Task &task)
+{
+    std::lock_guard<std::mutex> lock{mMutex};
+    if (mSize == capacity)
+        return false;
+
+    mTasks[(mOldest + mSize) % capacity] = task;
+    ++mSize;
+    return true;
+}
+
+bool WorkStealingPool::Queue::popNewest(Task &task)
+{
+    std::lock_guard<std::mutex> lock{mMutex};
+    if (mSize == 0)
+        return false;
+
+    --mSize;
+    task = mTasks[(mOldest + mSize) % capacity];
+    return true;
+}
+
+bool WorkStealingPool::Queue::popOldest(Task &task)
+{
+    std::lock_guard<std::mutex> lock{mMutex};
+    if (mSize == 0)
+        return false;
+
+    task = mTasks[mOldest];
+    mOldest = (mOldest + 1) % capacity;
+    --mSize;
+    return true;
+}
+
+WorkStealingPool::Worker::Worker(WorkStealingPool &pool, int queue)
+    : mPool{pool}, mQueue{queue}
+{
+    start();
+}
+
+WorkStealingPool::Worker::~Worker()
+{
+    stop();
+}
+
+void WorkStealingPool::Worker::run()
+{
+    mPool.work(mQueue);
+}
@@ -1,4 +1,7 @@
+#include <algorithm>
 #include <iostream>
+#include <atomic>
+#include <memory>
 #include <string>
 #include <fstream>
 #include <functional>
@@ -6,11 +9,19 @@
 #include <opencv2/opencv.hpp>
 #include <boost/asio.hpp>
 
+#include "Backoff.hpp"
 #include "Config.hpp"
+#include "ConfigSnapshot.hpp"
+#include "Metrics.hpp"
 #include "MJPEGWriter/MJPEGWriter.h"
+#include "PipelineExecutor.hpp"
+#include "RobotPacket.hpp"
+#include "TargetFilter.hpp"
 #include "Thread.hpp"
 #include "Contour.hpp"
+#include "GstCapture.hpp"
 #include "UDPHandler.hpp"
+#include "VisionPipeline.hpp"
 
 std::string configDir{"resources/config.yaml"};
 
@@ -19,20 +30,14 @@ VisionConfig visionConfig{};
 UvccamConfig uvccamConfig{};
 RaspicamConfig raspicamConfig{};
 
-template <typename T>
-T getYamlValue(YAML::Node yaml, std::string category, std::string setting)
-{
-    if (yaml[setting])
-        return yaml[setting].as<T>();
+// What the other threads read, republished on every parse. Only the main thread touches the configs above
+ConfigSnapshot<SystemConfig> systemSnapshot{};
+ConfigSnapshot<VisionConfig> visionSnapshot{};
+ConfigSnapshot<UvccamConfig> uvccamSnapshot{};
+ConfigSnapshot<RaspicamConfig> raspicamSnapshot{};
 
-    if (!yaml[category] || !yaml[category][setting])
-    {
-        std::cout << "Could not find setting " << setting << " in category " << category << '\n';
-        return T{};
-    }
-
-    return yaml[category][setting].as<T>();
-}
+// Filled in by the vision processing thread while system.metrics is on, and read by "get metrics"
+Metrics metrics{};
 
 void parseConfigs(YAML::Node yamlConfig)
 {
@@ -43,25 +48,12 @@ void parseConfigs(YAML::Node yamlConfig)
     configs.push_back(std::move(&raspicamConfig));
 
     for (Config *config : configs)
-    {
-        for (Setting *setting : config->settings)
-        {
-            if (dynamic_cast<IntSetting *>(setting) != nullptr)
-            {
-                dynamic_cast<IntSetting *>(setting)->value = getYamlValue<int>(yamlConfig, config->getTag(), setting->getTag());
-            }
-            else if (dynamic_cast<BoolSetting *>(setting) != nullptr)
-            {
-                dynamic_cast<BoolSetting *>(setting)->value = getYamlValue<bool>(yamlConfig, config->getTag(), setting->getTag());
-            }
-            else if (dynamic_cast<StringSetting *>(setting) != nullptr)
-            {
-                std::string value = getYamlValue<std::string>(yamlConfig, config->getTag(), setting->getTag());
-                if (value != std::string{})
-                    dynamic_cast<StringSetting *>(setting)->value = value;
-            }
-        }
-    }
+        config->parse(yamlConfig);
+
+    systemSnapshot.publish(systemConfig);
+    visionSnapshot.publish(visionConfig);
+    uvccamSnapshot.publish(uvccamConfig);
+    raspicamSnapshot.publish(raspicamConfig);
 
     if (systemConfig.verbose.value)
         std::cout << "Parsed Configs\n";
@@ -77,23 +69,7 @@ std::string getCurrentConfig()
 
     YAML::Node currentConfig;
     for (Config *config : configs)
-    {
-        for (Setting *setting : config->settings)
-        {
-            if (dynamic_cast<IntSetting *>(setting) != nullptr)
-            {
-                currentConfig[config->getTag()][setting->getTag()] = dynamic_cast<IntSetting *>(setting)->value;
-            }
-            else if (dynamic_cast<BoolSetting *>(setting) != nullptr)
-            {
-                currentConfig[config->getTag()][setting->getTag()] = dynamic_cast<BoolSetting *>(setting)->value;
-            }
-            else if (dynamic_cast<StringSetting *>(setting) != nullptr)
-            {
-                currentConfig[config->getTag()][setting->getTag()] = dynamic_cast<StringSetting *>(setting)->value;
-            }
-        }
-    }
+        config->emit(currentConfig);
 
     YAML::Emitter configEmitter;
     configEmitter.SetMapFormat(YAML::Block);
@@ -102,35 +78,125 @@ std::string getCurrentConfig()
     return configEmitter.c_str();
 }
 
-bool streamProcessingVideo{false};
+// Which camera is being streamed. Both are always capturing, so switching only changes which one writes to videoStream
+std::atomic<bool> streamProcessingVideo{false};
+
+// Both cameras are streamed through this, so switching between them doesn't touch any sockets
+std::unique_ptr<MJPEGWriter> videoStream;
+
+void configureVideoStream()
+{
+    videoStream->setScale(systemConfig.streamScale.value);
+    videoStream->setMetrics(systemConfig.metrics.value ? &metrics : nullptr);
+}
+
+void openVideoStream()
+{
+    videoStream.reset();
+    videoStream = std::make_unique<MJPEGWriter>(systemConfig.videoPort.value);
+    configureVideoStream();
+    videoStream->start();
+}
 
 // Streamer
 class : public Thread
 {
-public:
-    void stop() override
+private:
+    class StreamSource
     {
-        system("pkill mjpg_streamer");
-        Thread::stop();
-    }
+    public:
+        std::string description;
+        GstCapture::Format format;
+    };
 
-private:
     void run() override
     {
-        std::ostringstream command;
+        std::shared_ptr<const UvccamConfig> uvccam{uvccamSnapshot.get()};
 
-        // Configures camera settings
-        command << "v4l2-ctl -c exposure_auto=" << uvccamConfig.exposureAuto.value << " -c exposure_absolute=" << uvccamConfig.exposure.value;
-        system(command.str().c_str());
+        // Exposure is set through v4l2src itself rather than by running v4l2-ctl
+        std::ostringstream camera;
+        camera << "v4l2src extra-controls=\"c,exposure_auto=" << uvccam->exposureAuto.value << ",exposure_absolute=" << uvccam->exposure.value << "\"";
+        std::ostringstream size;
+        size << ",width=" << uvccam->width.value << ",height=" << uvccam->height.value;
 
-        if (systemConfig.verbose.value)
-            std::cout << "Configured Exposure\n";
+        // Cameras that encode MJPEG themselves have their frames served untouched, and raw frames are encoded here
+        // Without a camera a test pattern is streamed, to show the stream itself works, until the camera comes back
+        std::vector<StreamSource> sources{StreamSource{camera.str() + " ! image/jpeg" + size.str(), GstCapture::jpeg},
+                                          StreamSource{camera.str() + " ! video/x-raw" + size.str(), GstCapture::i420},
+                                          StreamSource{"videotestsrc is-live=true ! video/x-raw,framerate=15/1" + size.str(), GstCapture::i420}};
 
-        command = std::ostringstream{};
-        command << "cd ../mjpg-streamer-master/mjpg-streamer-experimental/ && ./mjpg_streamer -i 'input_uvc.so -r "
-                << uvccamConfig.width.value << "x" << uvccamConfig.height.value << " -e " << uvccamConfig.everyNthFrame.value
-                << "' -o 'output_http.so -p " << systemConfig.videoPort.value << "'";
-        system(command.str().c_str());
+        Backoff backoff{std::chrono::milliseconds{250}, std::chrono::seconds{4}};
+        GstCapture::Buffer buffer;
+
+        while (!stopFlag)
+        {
+            for (const StreamSource &source : sources)
+            {
+                GstCapture capture{source.description, source.format};
+                if (stopFlag || !capture.open() || !waitForFirstFrame(capture, buffer))
+                    continue;
+
+                if (systemSnapshot.get()->verbose.value)
+                    std::cout << "Streaming from " << source.description << '\n';
+
+                stream(capture, buffer, uvccam->everyNthFrame.value, &source == &sources.back());
+                buffer.release();
+                backoff.reset();
+                break;
+            }
+
+            backoff.wait(stopFlag);
+        }
+    }
+
+    // Sources that can't give us the format asked for only fail once they're playing, so a source only counts as
+    // working once a frame arrives
+    bool waitForFirstFrame(GstCapture &capture, GstCapture::Buffer &buffer)
+    {
+        std::chrono::steady_clock::time_point deadline{std::chrono::steady_clock::now() + std::chrono::seconds{2}};
+        while (!stopFlag && std::chrono::steady_clock::now() < deadline)
+        {
+            if (capture.read(buffer, std::chrono::milliseconds{100}))
+                return true;
+            if (capture.hasStopped())
+                return false;
+        }
+
+        return false;
+    }
+
+    // Streams until the source fails, or for a few seconds if it's the test pattern so the camera gets tried again
+    // A camera that stops sending frames without reporting an error counts as failed after a couple of seconds
+    void stream(GstCapture &capture, GstCapture::Buffer &buffer, int everyNthFrame, bool isTestPattern)
+    {
+        const int maxTimeouts{4};
+        std::chrono::steady_clock::time_point retryTime{std::chrono::steady_clock::now() + std::chrono::seconds{5}};
+        int frameNumber{0};
+        int timeouts{0};
+
+        // buffer already holds the first frame
+        bool haveFrame{true};
+        while (!stopFlag)
+        {
+            if (isTestPattern && std::chrono::steady_clock::now() > retryTime)
+                return;
+
+            // Like mjpg_streamer's -e, only every nth frame is sent
+            if (haveFrame && !streamProcessingVideo && frameNumber++ % std::max(everyNthFrame, 1) == 0)
+            {
+                if (capture.getFormat() == GstCapture::jpeg)
+                    videoStream->writeJpeg(buffer.frame);
+                else
+                    videoStream->writeI420(buffer.frame);
+            }
+
+            // A timeout leaves the last frame in buffer, which mustn't be sent again as if it were new
+            haveFrame = capture.read(buffer, std::chrono::milliseconds{500});
+            if (haveFrame)
+                timeouts = 0;
+            else if (capture.hasStopped() || ++timeouts >= maxTimeouts)
+                return;
+        }
     }
 } streamThread;
 
@@ -140,169 +206,220 @@ class : public Thread
 private:
     void run() override
     {
-        cv::Mat morphElement{cv::getStructuringElement(cv::MORPH_ELLIPSE, cv::Size(3, 3))};
+        // Settings that need this thread restarted to change. The rest are read from the newest snapshot as frames go
+        std::shared_ptr<const SystemConfig> startingSystemConfig{systemSnapshot.get()};
+        std::shared_ptr<const RaspicamConfig> raspicam{raspicamSnapshot.get()};
 
         UDPHandler robotUDPHandler{9999};
-        boost::asio::ip::udp::endpoint robotEndpoint{boost::asio::ip::address::from_string("10.28.51.2"), systemConfig.robotPort.value};
+        boost::asio::ip::udp::endpoint robotEndpoint{boost::asio::ip::address::from_string(startingSystemConfig->robotAddress.value), startingSystemConfig->robotPort.value};
 
+        // The camera produces BGR itself so frames reach us without any conversion
         std::ostringstream pipeline;
-        pipeline << "rpicamsrc shutter-speed=" << raspicamConfig.shutterSpeed.value << " exposure-mode=" << raspicamConfig.exposureMode.value
-                 << " ! video/x-raw,width=" << raspicamConfig.width.value << ",height=" << raspicamConfig.height.value << ",framerate="
-                 << raspicamConfig.fps.value << "/1 ! appsink";
+        pipeline << "rpicamsrc shutter-speed=" << raspicam->shutterSpeed.value << " exposure-mode=" << raspicam->exposureMode.value
+                 << " ! video/x-raw,format=BGR,width=" << raspicam->width.value << ",height=" << raspicam->height.value << ",framerate="
+                 << raspicam->fps.value << "/1";
 
-        cv::VideoCapture processingCamera{pipeline.str(), cv::CAP_GSTREAMER};
-        MJPEGWriter mjpegWriter{systemConfig.videoPort.value};
+        GstCapture processingCamera{pipeline.str()};
+        processingCamera.open();
+        Backoff cameraBackoff{std::chrono::milliseconds{250}, std::chrono::seconds{4}};
 
-        if (systemConfig.verbose.value && !processingCamera.isOpened())
+        if (startingSystemConfig->verbose.value && !processingCamera.isOpened())
             std::cout << "Could not open processing camera!\n";
 
+        VisionPipeline visionPipeline{visionSnapshot, raspicamSnapshot};
         cv::Mat streamFrame;
-        cv::Mat processingFrame;
-        for (int frameNumber{1}; !stopFlag; ++frameNumber)
-        {
-            if (!processingCamera.isOpened())
-                continue;
-
-            if (processingCamera.grab())
-                processingCamera.read(processingFrame);
-            else
-                continue;
-
-            if (processingFrame.empty())
-                continue;
-
-            if (systemConfig.verbose.value && frameNumber % 10 == 0)
-                std::cout << "Grabbed Frame " + std::to_string(frameNumber) + '\n';
-
-            if (streamProcessingVideo)
+        int frameNumber{0};
+        std::array<uint8_t, RobotPacket::maxSize> robotPacketBuffer;
+
+        // Both the publishing stage and the predictor send to the robot, so they take turns at the socket
+        // Predictions repeat the last frame's packet with the filtered values moved on
+        TargetFilter targetFilter;
+        std::mutex robotMutex;
+        RobotPacket lastRobotPacket;
+
+        auto addEstimate = [&targetFilter](RobotPacket &packet) {
+            std::chrono::steady_clock::time_point now{std::chrono::steady_clock::now()};
+            TargetEstimate estimate{targetFilter.predict(now)};
+            packet.filteredAngle = estimate.horizontalAngleError;
+            packet.filteredRate = estimate.angleRate;
+            packet.filteredConfidence = estimate.valid ? estimate.confidence : 0;
+            packet.processedTime = std::chrono::duration_cast<std::chrono::microseconds>(now.time_since_epoch()).count();
+        };
+
+        metrics.reset();
+
+        // Fills in between frames at system.robotRate, so the robot's control loop needn't wait on the camera
+        std::thread predictor{[&] {
+            std::array<uint8_t, RobotPacket::maxSize> predictionBuffer;
+            std::chrono::steady_clock::time_point nextSend{std::chrono::steady_clock::now()};
+
+            while (!stopFlag)
             {
-                if (!mjpegWriter.isOpened())
+                // Capped so a huge rate can't round the interval down to nothing and spin holding robotMutex
+                int rate{std::min(systemSnapshot.get()->robotRate.value, 1000)};
+                if (rate <= 0)
                 {
-                    mjpegWriter.write(processingFrame);
-                    mjpegWriter.start();
+                    std::this_thread::sleep_for(std::chrono::milliseconds{100});
+                    nextSend = std::chrono::steady_clock::now();
+                    continue;
                 }
-            }
-            else if (mjpegWriter.isOpened())
-                mjpegWriter.stop();
-
-            // Writes frame to be streamed when not tuning
-            if (streamProcessingVideo && !systemConfig.tuning.value)
-                mjpegWriter.write(processingFrame);
-
-            // Extracts the contours
-            std::vector<std::vector<cv::Point>> rawContours;
-            std::vector<Contour> contours;
-            cv::cvtColor(processingFrame, processingFrame, cv::COLOR_BGR2HSV);
-            cv::inRange(processingFrame, cv::Scalar{visionConfig.lowHue.value, visionConfig.lowSaturation.value, visionConfig.lowValue.value}, cv::Scalar{visionConfig.highHue.value, visionConfig.highSaturation.value, visionConfig.highValue.value}, processingFrame);
-            cv::erode(processingFrame, processingFrame, morphElement, cv::Point(-1, -1), 2);
-            cv::dilate(processingFrame, processingFrame, morphElement, cv::Point(-1, -1), 2);
-
-            // Writes vision processing frame to be streamed if requested
-            if (streamProcessingVideo && systemConfig.tuning.value)
-            {
-                // Writes the frame prepared last iteration
-                mjpegWriter.write(streamFrame);
 
-                // Begins preparing the new frame
-                processingFrame.copyTo(streamFrame);
-                cv::cvtColor(streamFrame, streamFrame, cv::COLOR_GRAY2BGR);
+                // Keeps to the rate without bursting to catch up after a stall
+                nextSend = std::max(nextSend + std::chrono::microseconds{1000000 / rate}, std::chrono::steady_clock::now());
+                std::this_thread::sleep_until(nextSend);
+
+                // Once the estimate has dropped out, repeating the last frame would keep telling the robot a target it
+                // can no longer trust is there, so the robot only hears from new frames until the filter picks one up
+                std::lock_guard<std::mutex> lock{robotMutex};
+                if (lastRobotPacket.frameNumber == 0 || !targetFilter.predict(std::chrono::steady_clock::now()).valid)
+                    continue;
+
+                RobotPacket packet{lastRobotPacket};
+                packet.flags |= RobotPacket::predicted;
+                addEstimate(packet);
+                robotUDPHandler.sendTo(predictionBuffer.data(), packet.write(predictionBuffer.data()), robotEndpoint);
             }
+        }};
 
-            cv::Canny(processingFrame, processingFrame, 0, 0);
-            cv::findContours(processingFrame, rawContours, cv::noArray(), cv::RETR_EXTERNAL, cv::CHAIN_APPROX_SIMPLE, cv::Point(0, 0));
+        // Capture, segmentation, target finding and publishing each get a core, so frame N + 1 is
+        // segmented while frame N is being paired
+        PipelineExecutor executor{{
+            [&](VisionFrame &frame) {
+                std::shared_ptr<const SystemConfig> currentSystemConfig{systemSnapshot.get()};
 
-            for (std::vector<cv::Point> pointsVector : rawContours)
-            {
-                Contour newContour{pointsVector};
-                if (newContour.isValid(visionConfig.minArea.value, visionConfig.maxArea.value, visionConfig.minRotation.value, visionConfig.allowableError.value))
+                // Without a camera, waits longer between each attempt to open it rather than spinning
+                if (!processingCamera.isOpened())
                 {
-                    contours.push_back(newContour);
+                    cameraBackoff.wait(stopFlag);
+                    if (stopFlag || !processingCamera.open())
+                        return false;
                 }
-            }
-
-            std::vector<std::array<Contour, 2>> pairs{};
 
-            // Least distant contour initialized with -1 so it's not confused for an actual contour and can be tested for not being valid
-            int leastDistantContour{-1};
+                frame.timed = currentSystemConfig->metrics.value;
+                if (frame.timed)
+                    frame.latencies.fill(std::chrono::nanoseconds{-1});
 
-            // Now that we've identified compliant targets, we find their match (if they have one)
-            for (int origContour{0}; origContour < contours.size(); ++origContour)
-            {
-                // We identify the left one first because why not
-                if (contours.at(origContour).angle > 0)
+                // Includes waiting for the camera
+                // read() sleeps until the appsink has a sample, so nothing spins while waiting for the camera
+                StageTimer timer{frame, Metrics::capture};
+                if (!processingCamera.read(frame.cameraBuffer, std::chrono::milliseconds{100}))
                 {
-                    // Iterates through all of the contours and compares them against the original
-                    for (int compareContour{0}; compareContour < contours.size(); ++compareContour)
+                    if (processingCamera.hasStopped())
                     {
-                        //If the contour to compare against isn't the original
-                        // and the contour is angled left
-                        // and the contour is right of the original
-                        // and (if the least distant contour hasn't been set
-                        // OR this contour is closer than the last least distant contour)
-                        // then this contour is the new least distant contour
-                        if (compareContour != origContour && contours.at(compareContour).angle < 0 && contours.at(origContour).rotatedBoundingBoxPoints[0].x < contours.at(compareContour).rotatedBoundingBoxPoints[0].x)
-                        {
-                            //We viewingCamera if it's closer to the original contour after checking if the
-                            // index is negative since passing a negative number to a vector will
-                            // throw an OutOfBounds exception
-                            if (leastDistantContour == -1)
-                            {
-                                leastDistantContour = compareContour;
-                            }
-                            else if (contours.at(compareContour).rotatedBoundingBoxPoints[0].x - contours.at(origContour).rotatedBoundingBoxPoints[0].x < contours.at(leastDistantContour).rotatedBoundingBoxPoints[0].x)
-                            {
-                                leastDistantContour = compareContour;
-                            }
-                        }
+                        if (currentSystemConfig->verbose.value)
+                            std::cout << "Lost processing camera, reconnecting\n";
+                        processingCamera.release();
                     }
+                    return false;
+                }
+                cameraBackoff.reset();
+
+                frame.captureTime = frame.cameraBuffer.captureTime;
+
+                // Only a header; the pixels stay in the camera's buffer
+                frame.frame = frame.cameraBuffer.frame;
+
+                frame.number = ++frameNumber;
+
+                if (currentSystemConfig->verbose.value && frame.number % 10 == 0)
+                    std::cout << "Grabbed Frame " + std::to_string(frame.number) + '\n';
+
+                return true;
+            },
+            [&](VisionFrame &frame) {
+                visionPipeline.segment(frame);
+                return true;
+            },
+            [&](VisionFrame &frame) {
+                visionPipeline.findTargets(frame);
+                return true;
+            },
+            [&](VisionFrame &frame) {
+                std::shared_ptr<const SystemConfig> currentSystemConfig{systemSnapshot.get()};
 
-                    // If we found the second contour, add the pair to the list
-                    if (leastDistantContour != -1)
+                targetFilter.update(frame, *frame.visionConfig);
+
+                {
+                    StageTimer timer{frame, Metrics::send};
+
+                    // Sent even without a target, so the robot knows the last one is gone
+                    RobotPacket packet;
+                    packet.flags = (frame.foundTarget ? RobotPacket::foundTarget : 0) |
+                                   (frame.roi.size() != frame.frame.size() ? RobotPacket::tracking : 0);
+                    packet.pairCount = frame.targets.size();
+                    packet.frameNumber = frame.number;
+                    packet.captureTime = std::chrono::duration_cast<std::chrono::microseconds>(frame.captureTime.time_since_epoch()).count();
+
+                    packet.targetCount = std::min<int>(frame.targets.size(), RobotPacket::maxTargets);
+                    for (int t{0}; t < packet.targetCount; ++t)
                     {
-                        pairs.push_back(std::array<Contour, 2>{contours.at(origContour), contours.at(leastDistantContour)});
-                        break;
+                        const Target &target{frame.targets.at(t)};
+                        packet.targets[t] = RobotTarget{static_cast<float>(target.horizontalAngleError), static_cast<float>(target.area),
+                                                        static_cast<float>(target.width), static_cast<float>(target.confidence)};
                     }
+
+                    std::lock_guard<std::mutex> lock{robotMutex};
+                    addEstimate(packet);
+                    robotUDPHandler.sendTo(robotPacketBuffer.data(), packet.write(robotPacketBuffer.data()), robotEndpoint);
+                    lastRobotPacket = packet;
                 }
-            }
 
-            if (pairs.size() == 0)
-                continue;
+                // Writes frame to be streamed when not tuning
+                if (streamProcessingVideo && !currentSystemConfig->tuning.value)
+                    videoStream->write(frame.frame);
 
-            std::array<Contour, 2> closestPair{pairs.back()};
-            for (int p{0}; p < pairs.size(); ++p)
-            {
-                double comparePairCenter{((std::max(pairs.at(p).at(0).rotatedBoundingBox.center.x, pairs.at(p).at(1).rotatedBoundingBox.center.x) - std::min(pairs.at(p).at(0).rotatedBoundingBox.center.x, pairs.at(p).at(1).rotatedBoundingBox.center.x)) / 2) + std::min(pairs.at(p).at(0).rotatedBoundingBox.center.x, pairs.at(p).at(1).rotatedBoundingBox.center.x)};
-                double closestPairCenter{((std::max(closestPair.at(0).rotatedBoundingBox.center.x, closestPair.at(1).rotatedBoundingBox.center.x) - std::min(closestPair.at(0).rotatedBoundingBox.center.x, closestPair.at(1).rotatedBoundingBox.center.x)) / 2) + std::min(closestPair.at(0).rotatedBoundingBox.center.x, closestPair.at(1).rotatedBoundingBox.center.x)};
-
-                if (std::abs(comparePairCenter) - (raspicamConfig.width.value / 2) <
-                    std::abs(closestPairCenter) - (raspicamConfig.width.value / 2))
+                // Writes vision processing frame to be streamed if requested
+                if (streamProcessingVideo && currentSystemConfig->tuning.value)
                 {
-                    closestPair = std::array<Contour, 2>{pairs.at(p).at(0), pairs.at(p).at(1)};
-                }
-            }
+                    StageTimer timer{frame, Metrics::overlay};
+
+                    // The mask only covers the searched region, which is outlined
+                    // Streamed as grayscale, a third of the pixels to encode, so overlays are told apart by brightness
+                    streamFrame.create(frame.frame.size(), CV_8UC1);
+                    streamFrame.setTo(cv::Scalar::all(0));
+                    cv::Mat streamRegion{streamFrame(frame.roi)};
+                    frame.mask.copyTo(streamRegion);
+                    cv::rectangle(streamFrame, frame.roi, cv::Scalar::all(96), 1);
 
-            // For clarity
-            double centerX{closestPair.at(0).rotatedBoundingBox.center.x + ((closestPair.at(1).rotatedBoundingBox.center.x - closestPair.at(0).rotatedBoundingBox.center.x) / 2)};
-            double centerY{closestPair.at(0).rotatedBoundingBox.center.y + ((closestPair.at(1).rotatedBoundingBox.center.y - closestPair.at(0).rotatedBoundingBox.center.y) / 2)};
+                    // With a detection scale, so are the regions searched at full resolution
+                    for (const cv::Rect &region : frame.regions)
+                        cv::rectangle(streamFrame, region, cv::Scalar::all(96), 1);
 
-            double horizontalAngleError{-((processingFrame.cols / 2.0) - centerX) / processingFrame.cols * raspicamConfig.horizontalFov.value};
+                    if (frame.foundTarget)
+                    {
+                        std::array<Contour, 2> &closestPair{frame.closestPair};
+                        double centerX{frame.centerX};
+                        double centerY{frame.centerY};
+
+                        cv::rectangle(streamFrame, closestPair.at(0).boundingBox, cv::Scalar::all(160), 2);
+                        cv::rectangle(streamFrame, closestPair.at(1).boundingBox, cv::Scalar::all(160), 2);
+                        cv::rectangle(streamFrame, cv::Rect{cv::Point2i{std::min(closestPair.at(0).boundingBox.x, closestPair.at(1).boundingBox.x), std::min(closestPair.at(0).boundingBox.y, closestPair.at(1).boundingBox.y)}, cv::Point2i{std::max(closestPair.at(0).boundingBox.x + closestPair.at(0).boundingBox.width, closestPair.at(1).boundingBox.x + closestPair.at(1).boundingBox.width), std::max(closestPair.at(0).boundingBox.y + closestPair.at(0).boundingBox.height, closestPair.at(1).boundingBox.y + closestPair.at(1).boundingBox.height)}}, cv::Scalar::all(255), 2);
+                        cv::line(streamFrame, cv::Point(centerX, centerY - 10), cv::Point(centerX, centerY + 10), cv::Scalar::all(255), 2);
+                        cv::line(streamFrame, cv::Point(centerX - 10, centerY), cv::Point(centerX + 10, centerY), cv::Scalar::all(255), 2);
+                        cv::putText(streamFrame, "Horizontal Angle of Error: " + std::to_string(frame.horizontalAngleError), cv::Point{0, 10}, cv::FONT_HERSHEY_SIMPLEX, 0.5, cv::Scalar::all(255));
+                    }
 
-            robotUDPHandler.sendTo(std::to_string(horizontalAngleError), robotEndpoint);
+                    videoStream->write(streamFrame);
+                }
 
-            // Preps frame to be streamed
-            if (streamProcessingVideo && systemConfig.tuning.value)
-            {
-                cv::rectangle(streamFrame, closestPair.at(0).boundingBox, cv::Scalar{0, 127.5, 255}, 2);
-                cv::rectangle(streamFrame, closestPair.at(1).boundingBox, cv::Scalar{0, 127.5, 255}, 2);
-                cv::rectangle(streamFrame, cv::Rect{cv::Point2i{std::min(closestPair.at(0).boundingBox.x, closestPair.at(1).boundingBox.x), std::min(closestPair.at(0).boundingBox.y, closestPair.at(1).boundingBox.y)}, cv::Point2i{std::max(closestPair.at(0).boundingBox.x + closestPair.at(0).boundingBox.width, closestPair.at(1).boundingBox.x + closestPair.at(1).boundingBox.width), std::max(closestPair.at(0).boundingBox.y + closestPair.at(0).boundingBox.height, closestPair.at(1).boundingBox.y + closestPair.at(1).boundingBox.height)}}, cv::Scalar{0, 255, 0}, 2);
-                cv::line(streamFrame, cv::Point{centerX, centerY - 10}, cv::Point{centerX, centerY + 10}, cv::Scalar{0, 255, 0}, 2);
-                cv::line(streamFrame, cv::Point{centerX - 10, centerY}, cv::Point{centerX + 10, centerY}, cv::Scalar{0, 255, 0}, 2);
-                cv::putText(streamFrame, "Horizontal Angle of Error: " + std::to_string(horizontalAngleError), cv::Point{0, 10}, cv::FONT_HERSHEY_SIMPLEX, 0.5, cv::Scalar{255, 255, 255});
-            }
-            std::this_thread::sleep_for(std::chrono::milliseconds{10});
-        }
+                if (frame.timed)
+                {
+                    metrics.record(Metrics::total, std::chrono::steady_clock::now() - frame.captureTime);
+                    for (int stage{0}; stage < Metrics::total; ++stage)
+                    {
+                        if (frame.latencies[stage].count() >= 0)
+                            metrics.record(static_cast<Metrics::Stage>(stage), frame.latencies[stage]);
+                    }
+                }
+
+                return true;
+            }}};
+
+        executor.run(stopFlag);
+        predictor.join();
 
-        mjpegWriter.stop();
+        if (startingSystemConfig->verbose.value)
+            std::cout << "Dropped " << executor.getDroppedFrames() << " stale frames\n";
     }
 } processVisionThread;
 
@@ -310,107 +427,131 @@ int main()
 {
     parseConfigs(YAML::LoadFile(configDir));
 
+    openVideoStream();
     streamThread.start();
     processVisionThread.start();
 
-    UDPHandler communicatorUDPHandler{systemConfig.receivePort.value};
+    UDPHandler communicatorUDPHandler{systemConfig.receivePort.value, true};
 
+    UDPHandler::Datagram datagram;
     while (true)
     {
-        if (communicatorUDPHandler.getMessage() != "")
+        // Sleeps until a command arrives, and handles every one in the order they came
+        if (!communicatorUDPHandler.receive(datagram, std::chrono::seconds{1}))
+            continue;
+
+        const std::string &message{datagram.message};
+
+        std::string configsLabel{"CONFIGS:"};
+
+        // If we were sent configs
+        if (message.find(configsLabel) != std::string::npos)
         {
-            std::string configsLabel{"CONFIGS:"};
+            SystemConfig previousSystemConfig{systemConfig};
+            UvccamConfig previousUvccamConfig{uvccamConfig};
+            RaspicamConfig previousRaspicamConfig{raspicamConfig};
 
-            // If we were sent configs
-            if (communicatorUDPHandler.getMessage().find(configsLabel) != std::string::npos)
-            {
-                parseConfigs(YAML::Load(communicatorUDPHandler.getMessage().substr(configsLabel.length()).c_str()));
+            // Vision settings, verbose and tuning apply from the next frame once these are published
+            parseConfigs(YAML::Load(message.substr(configsLabel.length()).c_str()));
 
-                // Puts the system on read-write mode
-                system("sudo mount -o remount,rw /");
+            // Puts the system on read-write mode
+            system("sudo mount -o remount,rw /");
 
-                // Writes the changes to file
-                remove(configDir.c_str());
-                std::ofstream file;
-                file.open(configDir);
+            // Writes the changes to file
+            remove(configDir.c_str());
+            std::ofstream file;
+            file.open(configDir);
 
-                if (!file.is_open())
-                    std::cout << "Failed to open configuration file\n";
+            if (!file.is_open())
+                std::cout << "Failed to open configuration file\n";
 
-                file << getCurrentConfig() << '\n';
+            file << getCurrentConfig() << '\n';
 
-                file.close();
+            file.close();
 
-                // Puts the system back on read-only
-                system("sudo mount -o remount,ro /");
+            // Puts the system back on read-only
+            system("sudo mount -o remount,ro /");
 
-                if (systemConfig.verbose.value)
-                    std::cout << "Updated Configurations\n";
+            if (systemConfig.verbose.value)
+                std::cout << "Updated Configurations\n";
 
-                if (!systemConfig.tuning.value)
-                {
+            configureVideoStream();
+
+            // Only threads whose cameras, sockets or stream changed are restarted
+            if (!systemConfig.tuning.value)
+            {
+                bool videoPortChanged{systemConfig.videoPort.value != previousSystemConfig.videoPort.value};
+                bool robotChanged{systemConfig.robotAddress.value != previousSystemConfig.robotAddress.value ||
+                                  systemConfig.robotPort.value != previousSystemConfig.robotPort.value};
+                bool restartStream{videoPortChanged || !uvccamConfig.hasSameValues(previousUvccamConfig)};
+                bool restartVision{videoPortChanged || robotChanged || !raspicamConfig.hasSameCameraSettings(previousRaspicamConfig)};
+
+                if (restartStream)
                     streamThread.stop();
+                if (restartVision)
                     processVisionThread.stop();
 
-                    while (streamThread.isRunning || processVisionThread.isRunning)
-                    {
-                        std::cout << "Waiting for streaming and vision processing streams to end...\n";
-                        std::this_thread::sleep_for(std::chrono::milliseconds{500});
-                    }
+                while ((restartStream && streamThread.isRunning) || (restartVision && processVisionThread.isRunning))
+                {
+                    std::cout << "Waiting for streaming and vision processing streams to end...\n";
+                    std::this_thread::sleep_for(std::chrono::milliseconds{500});
+                }
 
-                    if (!streamProcessingVideo)
-                        streamThread.start();
+                // Nothing is writing to it now
+                if (videoPortChanged)
+                    openVideoStream();
 
+                if (restartStream)
+                    streamThread.start();
+                if (restartVision)
                     processVisionThread.start();
-                }
             }
-            else if (communicatorUDPHandler.getMessage() == "get config")
-            {
-                std::string configTag{"CONFIGS:\n"};
-
-                communicatorUDPHandler.reply(configTag + getCurrentConfig());
+        }
+        else if (message == "get config")
+        {
+            std::string configTag{"CONFIGS:\n"};
 
-                if (systemConfig.verbose.value)
-                    std::cout << "Sent Configurations\n";
-            }
-            else if (communicatorUDPHandler.getMessage() == "switch camera")
-            {
-                bool newStreamProcessingVideo = !streamProcessingVideo;
+            communicatorUDPHandler.sendTo(configTag + getCurrentConfig(), datagram.sender);
 
-                if (!newStreamProcessingVideo)
-                    streamThread.start();
-                else
-                    streamThread.stop();
+            if (systemConfig.verbose.value)
+                std::cout << "Sent Configurations\n";
+        }
+        else if (message == "get metrics")
+        {
+            std::string metricsTag{"METRICS:\n"};
 
-                streamProcessingVideo = newStreamProcessingVideo;
+            communicatorUDPHandler.sendTo(metricsTag + metrics.getReport(), datagram.sender);
 
-                if (systemConfig.verbose.value)
-                    std::cout << "Switched Camera Stream\n";
-            }
-            else if (communicatorUDPHandler.getMessage() == "restart program")
-            {
-                if (systemConfig.verbose.value)
-                    std::cout << "Restarting program...\n";
+            if (systemConfig.verbose.value)
+                std::cout << "Sent Metrics\n";
+        }
+        else if (message == "switch camera")
+        {
+            streamProcessingVideo = !streamProcessingVideo;
 
-                streamThread.stop();
-                processVisionThread.stop();
-                break;
-            }
-            else if (communicatorUDPHandler.getMessage() == "reboot")
-            {
-                if (systemConfig.verbose.value)
-                    std::cout << "Rebooting...\n";
+            if (systemConfig.verbose.value)
+                std::cout << "Switched Camera Stream\n";
+        }
+        else if (message == "restart program")
+        {
+            if (systemConfig.verbose.value)
+                std::cout << "Restarting program...\n";
 
-                system("sudo reboot -h now");
-            }
-            else
-            {
-                std::cout << "Received unknown command via UDP: " + communicatorUDPHandler.getMessage() + '\n';
-            }
+            streamThread.stop();
+            processVisionThread.stop();
+            break;
+        }
+        else if (message == "reboot")
+        {
+            if (systemConfig.verbose.value)
+                std::cout << "Rebooting...\n";
 
-            communicatorUDPHandler.clearMessage();
+            system("sudo reboot -h now");
+        }
+        else
+        {
+            std::cout << "Received unknown command via UDP: " + message + '\n';
         }
-        std::this_thread::sleep_for(std::chrono::milliseconds{250});
     }
 
     return 0;
@@ -0,0 +1,101 @@
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <boost/asio.hpp>
+
+#include "RobotPacket.hpp"
+
+// Stands in for the robot: listens for packets, checks they arrive in order and prints how stale they are
+// Predicted packets between frames repeat the last frame's number and are left out of the latency figures
+// Run it on the coprocessor itself with system.robotAddress set to 127.0.0.1, since the end-to-end latency compares
+// the packet's times against this machine's steady clock
+// Usage: RobotReceiver [port] [packets between summaries]
+
+double millisecondsBetween(int64_t startMicroseconds, int64_t endMicroseconds)
+{
+    return (endMicroseconds - startMicroseconds) / 1000.0;
+}
+
+int main(int argc, char *argv[])
+{
+    int port{argc > 1 ? std::stoi(argv[1]) : 1183};
+    int summaryInterval{argc > 2 ? std::stoi(argv[2]) : 100};
+
+    boost::asio::io_service ioService;
+    boost::asio::ip::udp::socket socket{ioService, boost::asio::ip::udp::endpoint{boost::asio::ip::udp::v4(), static_cast<unsigned short>(port)}};
+
+    std::cout << "Listening on port " << port << '\n';
+
+    int64_t lastFrameNumber{-1};
+    int received{0}, predicted{0}, outOfOrder{0}, malformed{0};
+    double maxProcessing{0}, maxEndToEnd{0}, totalProcessing{0}, totalEndToEnd{0};
+
+    uint8_t buffer[1024];
+    while (true)
+    {
+        boost::asio::ip::udp::endpoint sender;
+        size_t bytes{socket.receive_from(boost::asio::buffer(buffer), sender)};
+        int64_t arrivalTime{std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count()};
+
+        RobotPacket packet;
+        if (!packet.read(buffer, bytes))
+        {
+            ++malformed;
+            std::cout << "Malformed packet of " << bytes << " bytes, version " << static_cast<int>(bytes > 0 ? buffer[0] : 0) << '\n';
+            continue;
+        }
+
+        // Frames dropped on the coprocessor leave gaps, which are fine, but going backwards isn't
+        bool isPrediction{(packet.flags & RobotPacket::predicted) != 0};
+        if (static_cast<int64_t>(packet.frameNumber) < lastFrameNumber || (!isPrediction && static_cast<int64_t>(packet.frameNumber) == lastFrameNumber))
+        {
+            ++outOfOrder;
+            std::cout << "Frame " << packet.frameNumber << " arrived after frame " << lastFrameNumber << '\n';
+        }
+        lastFrameNumber = std::max<int64_t>(lastFrameNumber, packet.frameNumber);
+
+        std::cout << "Frame " << packet.frameNumber << (isPrediction ? " predicted: " : ": ");
+        if (packet.filteredConfidence > 0)
+            std::cout << "filtered " << packet.filteredAngle << " degrees at " << packet.filteredRate << " degrees/s, confidence " << packet.filteredConfidence;
+        else
+            std::cout << "no estimate";
+
+        if (isPrediction)
+        {
+            ++predicted;
+            std::cout << '\n';
+            continue;
+        }
+
+        double processing{millisecondsBetween(packet.captureTime, packet.processedTime)};
+        double endToEnd{millisecondsBetween(packet.captureTime, arrivalTime)};
+        ++received;
+        totalProcessing += processing;
+        totalEndToEnd += endToEnd;
+        maxProcessing = std::max(maxProcessing, processing);
+        maxEndToEnd = std::max(maxEndToEnd, endToEnd);
+
+        if (packet.flags & RobotPacket::foundTarget)
+        {
+            const RobotTarget &target{packet.targets[0]};
+            std::cout << ", measured " << target.horizontalAngleError << " degrees, area " << target.area << ", width " << target.width << ", confidence "
+                      << target.confidence << ", " << packet.pairCount << " pairs";
+        }
+        else
+        {
+            std::cout << ", no target";
+        }
+        std::cout << (packet.flags & RobotPacket::tracking ? ", tracking" : "") << ", captured " << processing << " ms before sending, "
+                  << endToEnd << " ms before arriving\n";
+
+        if (received % summaryInterval == 0)
+        {
+            std::cout << received << " frame packets, " << predicted << " predicted, " << outOfOrder << " out of order, " << malformed << " malformed, capture to send mean "
+                      << totalProcessing / received << " ms max " << maxProcessing << " ms, capture to arrival mean "
+                      << totalEndToEnd / received << " ms max " << maxEndToEnd << " ms\n";
+        }
+    }
+
+    return 0;
+}